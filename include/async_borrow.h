@@ -0,0 +1,129 @@
+#pragma once
+
+#include "message_pool.h"
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define MESSAGE_POOL_HAVE_COROUTINES 1
+#endif
+#endif
+
+#ifdef MESSAGE_POOL_HAVE_COROUTINES
+
+// Awaitable returned by asyncBorrow(). Completes at once when a slot is free;
+// otherwise the coroutine joins the pool's waiter queue without blocking any
+// thread, and the release() that frees a slot hands it over directly and
+// resumes the coroutine through executor.post(f). post() is called with the
+// pool lock held, so it must only queue f. There is no timeout; destroying a
+// suspended coroutine gives back its place in the queue, or its slot if one
+// was already handed over (the executor must then drop the queued resume).
+// After MessagePool::shutdown() the co_await throws, as borrow() would.
+template <class Executor>
+class BorrowAwaiter {
+public:
+    BorrowAwaiter(MessagePool& pool, Executor& executor, Priority priority, CallSite site)
+        : pool_(pool), executor_(executor), priority_(priority), site_(site) {
+        node_.self = this;
+        node_.priority = static_cast<size_t>(priority);
+        node_.resume = &BorrowAwaiter::schedule;
+    }
+
+    BorrowAwaiter(const BorrowAwaiter&) = delete;
+    BorrowAwaiter& operator=(const BorrowAwaiter&) = delete;
+
+    ~BorrowAwaiter() {
+        if (!suspended_ || msg_) return;
+        std::condition_variable* wake = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(pool_.mutex_);
+            if (node_.cancelled) {
+                // Already dequeued by shutdown()
+            } else if (node_.slot == MessagePool::kNoSlot) {
+                pool_.unlink(&node_);
+            } else {
+                wake = pool_.freeSlot(node_.slot);
+            }
+        }
+        if (wake) wake->notify_one();
+    }
+
+    bool await_ready() {
+        msg_ = pool_.tryBorrow(priority_, site_);
+        return msg_ != nullptr;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        std::unique_lock<std::mutex> lock(pool_.mutex_);
+        if (pool_.shutdown_) {
+            node_.cancelled = true;
+            return false;
+        }
+        if (!pool_.mustWait(priority_)) { // Freed since await_ready()
+            msg_ = pool_.borrowSlot(pool_.takeFree(), priority_, site_);
+            lock.unlock();
+            pool_.scrubBorrowed(&msg_, 1);
+            return false;
+        }
+
+        MESSAGE_POOL_PROBE1(wait__begin, pool_.poolId_);
+        pool_.record(PoolEvent::Wait, 0);
+        pool_.priorities_[node_.priority].waits.fetch_add(1, std::memory_order_relaxed);
+        handle_ = handle;
+        start_ = std::chrono::steady_clock::now();
+        pool_.enqueue(&node_);
+        suspended_ = true;
+        pool_.reclaimAllRemote(); // May hand the slot over, scheduling the resume
+        return true;
+    }
+
+    NetworkMessage* await_resume() {
+        if (msg_) return msg_;
+        if (node_.cancelled) throw std::runtime_error("Message pool is shut down");
+
+        uint64_t waitedNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count());
+        MESSAGE_POOL_PROBE2(wait__end, pool_.poolId_, waitedNs);
+        pool_.stats_.onWait(waitedNs);
+        pool_.waitTime_.record(waitedNs);
+
+        {
+            std::lock_guard<std::mutex> lock(pool_.mutex_);
+            msg_ = pool_.borrowSlot(node_.slot, priority_, site_);
+        }
+        pool_.scrubBorrowed(&msg_, 1);
+        return msg_;
+    }
+
+private:
+    struct Node : MessagePool::Waiter {
+        BorrowAwaiter* self = nullptr;
+    };
+
+    // Runs in the releasing thread, under the pool lock.
+    static void schedule(MessagePool::Waiter* waiter) {
+        BorrowAwaiter* self = static_cast<Node*>(waiter)->self;
+        std::coroutine_handle<> handle = self->handle_;
+        self->executor_.post([handle]() { handle.resume(); });
+    }
+
+    MessagePool& pool_;
+    Executor& executor_;
+    Priority priority_;
+    CallSite site_;
+    Node node_;
+    NetworkMessage* msg_ = nullptr;
+    bool suspended_ = false;
+    std::coroutine_handle<> handle_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// co_await asyncBorrow(pool, loop) borrows without blocking the thread.
+// Executor is anything with post(f) that later runs f on the loop.
+template <class Executor>
+BorrowAwaiter<Executor> asyncBorrow(MessagePool& pool, Executor& executor, Priority priority = Priority::Normal,
+                                    CallSite site = CallSite::current()) {
+    return {pool, executor, priority, site};
+}
+
+#endif
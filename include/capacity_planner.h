@@ -0,0 +1,111 @@
+#pragma once
+
+#include "message_pool.h"
+#include "trace_replay.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+struct CapacityOption {
+    size_t capacity;
+    double waitProbability; // Chance a borrow finds the pool empty
+    size_t footprintBytes;  // MessagePool::footprint(capacity)
+};
+
+// Sizes a pool for a target probability that borrow() has to wait. Demand
+// comes either from a recorded trace (the empirical number of messages held
+// whenever a borrow arrived) or from live stats (borrow rate and mean hold
+// time, fed to the Erlang C formula for an M/M/c queue).
+class CapacityPlanner {
+public:
+    // Messages already held at the moment of each recorded borrow.
+    static CapacityPlanner fromTrace(const Trace& trace) {
+        CapacityPlanner planner;
+        std::vector<bool> held(trace.capacity, false);
+        size_t inUse = 0;
+        for (const TraceEvent& ev : trace.events) {
+            if (ev.op == static_cast<uint8_t>(PoolEvent::Wait)) {
+                planner.saturated_ = true;
+            }
+            if (ev.slot >= held.size()) continue;
+            if (ev.op == static_cast<uint8_t>(PoolEvent::Borrow) && !held[ev.slot]) {
+                planner.demand_.push_back(inUse);
+                held[ev.slot] = true;
+                ++inUse;
+            } else if (ev.op == static_cast<uint8_t>(PoolEvent::Release) && held[ev.slot]) {
+                held[ev.slot] = false;
+                --inUse;
+            }
+        }
+        std::sort(planner.demand_.begin(), planner.demand_.end());
+        return planner;
+    }
+
+    // borrowsPerSecond and meanHoldNs give the offered load in messages held.
+    static CapacityPlanner fromRates(double borrowsPerSecond, double meanHoldNs) {
+        CapacityPlanner planner;
+        planner.offeredLoad_ = borrowsPerSecond * meanHoldNs / 1e9;
+        planner.analytic_ = true;
+        return planner;
+    }
+
+    double waitProbability(size_t capacity) const {
+        if (analytic_) return erlangC(capacity, offeredLoad_);
+        if (demand_.empty()) return 0;
+
+        auto firstWaiting = std::lower_bound(demand_.begin(), demand_.end(), capacity);
+        size_t waited = static_cast<size_t>(demand_.end() - firstWaiting);
+        return static_cast<double>(waited) / static_cast<double>(demand_.size());
+    }
+
+    // Smallest capacity whose wait probability is at most target.
+    CapacityOption recommend(double target, size_t maxCapacity = 1 << 20) const {
+        size_t capacity = 1;
+        while (capacity < maxCapacity && waitProbability(capacity) > target) ++capacity;
+        return option(capacity);
+    }
+
+    CapacityOption option(size_t capacity) const {
+        return {capacity, waitProbability(capacity), MessagePool::footprint(capacity)};
+    }
+
+    // True when the recording itself ran out of messages: demand above the
+    // recorded capacity was never observed, so trace-based answers are a
+    // lower bound. Re-record with a larger pool.
+    bool saturated() const { return saturated_; }
+
+    double offeredLoad() const { return offeredLoad_; }
+
+    // Probability of waiting in an M/M/c queue with c servers and offered
+    // load a (Erlang C), computed via the Erlang B recurrence.
+    static double erlangC(size_t servers, double load) {
+        if (load <= 0) return 0;
+        if (static_cast<double>(servers) <= load) return 1;
+
+        double b = 1;
+        for (size_t k = 1; k <= servers; ++k) {
+            b = load * b / (static_cast<double>(k) + load * b);
+        }
+        double c = static_cast<double>(servers);
+        return c * b / (c - load * (1 - b));
+    }
+
+    // Mean of a log2 histogram, taking each bucket at its midpoint.
+    static double approximateMean(const HistogramSnapshot& hist) {
+        double sum = 0;
+        uint64_t count = 0;
+        for (size_t i = 0; i < HistogramSnapshot::kBuckets; ++i) {
+            if (hist.buckets[i] == 0) continue;
+            double mid = i == 0 ? 0 : 1.5 * std::ldexp(1.0, static_cast<int>(i) - 1);
+            sum += mid * static_cast<double>(hist.buckets[i]);
+            count += hist.buckets[i];
+        }
+        return count ? sum / static_cast<double>(count) : 0;
+    }
+
+private:
+    std::vector<size_t> demand_; // Sorted
+    double offeredLoad_ = 0;
+    bool analytic_ = false;
+    bool saturated_ = false;
+};
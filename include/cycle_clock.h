@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Cheap timestamps for hot-path timing: the TSC on x86, the virtual counter on
+// AArch64, steady_clock elsewhere. Ticks are converted to nanoseconds with a
+// ratio calibrated once per process.
+struct CycleClock {
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t ticks;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+        return ticks;
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    static uint64_t toNanos(uint64_t ticks) {
+        return static_cast<uint64_t>(static_cast<double>(ticks) * nanosPerTick());
+    }
+
+    // Calibrates on first call (a few milliseconds); call it up front to keep
+    // that off any latency-sensitive path.
+    static double nanosPerTick() {
+        static const double ratio = calibrate();
+        return ratio;
+    }
+
+private:
+    static double calibrate() {
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+        auto wallStart = std::chrono::steady_clock::now();
+        uint64_t tickStart = now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        uint64_t ticks = now() - tickStart;
+        auto wall = std::chrono::steady_clock::now() - wallStart;
+        double nanos = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(wall).count());
+        return ticks ? nanos / static_cast<double>(ticks) : 1.0;
+#else
+        return 1.0;
+#endif
+    }
+};
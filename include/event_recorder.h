@@ -0,0 +1,192 @@
+#pragma once
+
+#include "cycle_clock.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class PoolEvent : uint8_t {
+    Borrow = 1,  // slot handed out
+    Release = 2, // slot returned
+    Wait = 3,    // borrow found the pool empty and blocked
+    Timeout = 4, // borrow gave up
+};
+
+// One recorded pool operation; 16 bytes on disk.
+struct TraceEvent {
+    uint64_t timestampNs; // Since the recorder was created
+    uint32_t slot;        // Slot index (0 for Wait/Timeout)
+    uint16_t thread;      // Recorder-assigned thread number
+    uint8_t op;           // PoolEvent
+    uint8_t reserved;
+};
+static_assert(sizeof(TraceEvent) == 16, "TraceEvent is a file format");
+
+// Trace file layout: this header followed by TraceEvents. Events are grouped
+// per thread in flush order, so readers sort by timestamp.
+struct TraceFileHeader {
+    static constexpr uint64_t kMagic = 0x0045434152544d50ULL; // "PMTRACE"
+    static constexpr uint32_t kVersion = 1;
+
+    uint64_t magic;
+    uint32_t version;
+    uint32_t eventSize;
+    uint64_t capacity; // Capacity of the recorded pool
+};
+
+// Low-overhead recorder for pool events. Each thread appends to its own
+// fixed-size ring without locks or syscalls; a background thread drains the
+// rings to the trace file. Events that arrive while a ring is full are
+// dropped and counted rather than blocking the caller.
+class EventRecorder {
+public:
+    EventRecorder(const std::string& path, size_t poolCapacity, size_t ringSize = 1 << 14,
+                  std::chrono::milliseconds flushInterval = std::chrono::milliseconds(10))
+        : ringSize_(roundUpPow2(ringSize)), flushInterval_(flushInterval),
+          generation_(nextGeneration()), startTicks_(CycleClock::now()) {
+        CycleClock::nanosPerTick();
+        file_ = std::fopen(path.c_str(), "wb");
+        if (!file_) {
+            throw std::runtime_error("Failed to open trace file: " + path);
+        }
+
+        TraceFileHeader header{TraceFileHeader::kMagic, TraceFileHeader::kVersion,
+                               sizeof(TraceEvent), poolCapacity};
+        std::fwrite(&header, sizeof(header), 1, file_);
+
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    EventRecorder(const EventRecorder&) = delete;
+    EventRecorder& operator=(const EventRecorder&) = delete;
+
+    ~EventRecorder() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+        flush();
+        std::fclose(file_);
+    }
+
+    // Hot path: a thread-local lookup and one ring write.
+    void record(PoolEvent op, size_t slot) {
+        ThreadRing& ring = threadRing();
+        uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+        if (tail - ring.head.load(std::memory_order_acquire) == ringSize_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        TraceEvent& ev = ring.events[tail & (ringSize_ - 1)];
+        ev.timestampNs = CycleClock::now() - startTicks_; // Converted to ns when flushed
+        ev.slot = static_cast<uint32_t>(slot);
+        ev.thread = ring.thread;
+        ev.op = static_cast<uint8_t>(op);
+        ev.reserved = 0;
+        ring.tail.store(tail + 1, std::memory_order_release);
+    }
+
+    // Drains every thread's ring to the file.
+    void flush() {
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        double nanosPerTick = CycleClock::nanosPerTick();
+        for (auto& ring : rings_) {
+            uint64_t head = ring->head.load(std::memory_order_relaxed);
+            uint64_t tail = ring->tail.load(std::memory_order_acquire);
+            buffer_.clear();
+            for (uint64_t i = head; i < tail; ++i) {
+                TraceEvent ev = ring->events[i & (ringSize_ - 1)];
+                ev.timestampNs = static_cast<uint64_t>(static_cast<double>(ev.timestampNs) * nanosPerTick);
+                buffer_.push_back(ev);
+            }
+            ring->head.store(tail, std::memory_order_release);
+            if (!buffer_.empty()) {
+                std::fwrite(buffer_.data(), sizeof(TraceEvent), buffer_.size(), file_);
+            }
+        }
+        std::fflush(file_);
+    }
+
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    struct ThreadRing {
+        ThreadRing(size_t size, uint16_t id) : events(size), thread(id), owner(std::this_thread::get_id()) {}
+
+        std::vector<TraceEvent> events;
+        alignas(64) std::atomic<uint64_t> head{0}; // Advanced by the flusher
+        alignas(64) std::atomic<uint64_t> tail{0}; // Advanced by the owning thread
+        uint16_t thread;
+        std::thread::id owner;
+    };
+
+    static size_t roundUpPow2(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    static uint64_t nextGeneration() {
+        static std::atomic<uint64_t> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Each thread caches its ring for the recorder it last used; the
+    // generation guards against a new recorder reusing a freed address.
+    ThreadRing& threadRing() {
+        struct Cache {
+            uint64_t generation = 0;
+            ThreadRing* ring = nullptr;
+        };
+        thread_local Cache cache;
+        if (cache.generation != generation_) {
+            cache = {generation_, &findOrAddRing()};
+        }
+        return *cache.ring;
+    }
+
+    ThreadRing& findOrAddRing() {
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        for (auto& ring : rings_) {
+            if (ring->owner == std::this_thread::get_id()) return *ring;
+        }
+        rings_.push_back(std::make_unique<ThreadRing>(ringSize_, static_cast<uint16_t>(rings_.size())));
+        return *rings_.back();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!cv_.wait_for(lock, flushInterval_, [this]() { return stop_; })) {
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    size_t ringSize_;
+    std::chrono::milliseconds flushInterval_;
+    uint64_t generation_;
+    uint64_t startTicks_;
+    std::FILE* file_ = nullptr;
+    std::atomic<uint64_t> dropped_{0};
+
+    std::mutex ringsMutex_; // Guards rings_, buffer_ and the file
+    std::vector<std::unique_ptr<ThreadRing>> rings_;
+    std::vector<TraceEvent> buffer_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bucket 0 holds zero; bucket i holds values in [2^(i-1), 2^i); the last
+// bucket also takes everything larger.
+struct HistogramSnapshot {
+    static constexpr size_t kBuckets = 64;
+
+    std::array<uint64_t, kBuckets> buckets{};
+
+    uint64_t count() const {
+        uint64_t total = 0;
+        for (uint64_t b : buckets) total += b;
+        return total;
+    }
+
+    // Upper bound of the bucket holding quantile q (0..1): the reported value
+    // is at most 2x the true one. Returns 0 for an empty histogram.
+    uint64_t percentile(double q) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total));
+        if (rank >= total) rank = total - 1;
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += buckets[i];
+            if (seen > rank) return upperBound(i);
+        }
+        return upperBound(kBuckets - 1);
+    }
+
+    static uint64_t upperBound(size_t bucket) {
+        if (bucket == 0) return 0;
+        if (bucket >= kBuckets - 1) return UINT64_MAX;
+        return (uint64_t(1) << bucket) - 1;
+    }
+};
+
+// Lock-free log2-bucketed histogram: one relaxed increment per sample.
+// Counter is std::atomic, or a lock policy's counter type.
+template <template <class> class Counter>
+class BasicLatencyHistogram {
+public:
+    void record(uint64_t value) {
+        buckets_[bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    HistogramSnapshot snapshot() const {
+        HistogramSnapshot snap;
+        for (size_t i = 0; i < HistogramSnapshot::kBuckets; ++i) {
+            snap.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        }
+        return snap;
+    }
+
+    static size_t bucketFor(uint64_t value) {
+        if (value == 0) return 0;
+        size_t bucket = 64 - static_cast<size_t>(__builtin_clzll(value));
+        return bucket < HistogramSnapshot::kBuckets ? bucket : HistogramSnapshot::kBuckets - 1;
+    }
+
+private:
+    std::array<Counter<uint64_t>, HistogramSnapshot::kBuckets> buckets_{};
+};
+
+using LatencyHistogram = BasicLatencyHistogram<std::atomic>;
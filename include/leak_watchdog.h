@@ -0,0 +1,78 @@
+#pragma once
+
+#include "message_pool.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Background thread that scans a pool for messages held longer than a
+// threshold and reports each offending borrow once. The default reporter
+// writes one line per message to stderr.
+class LeakWatchdog {
+public:
+    using Reporter = std::function<void(const HeldMessage&)>;
+
+    LeakWatchdog(const MessagePool& pool, std::chrono::nanoseconds threshold,
+                 std::chrono::milliseconds interval = std::chrono::milliseconds(1000),
+                 Reporter reporter = printToStderr)
+        : pool_(pool), threshold_(threshold), interval_(interval), reporter_(std::move(reporter)),
+          reported_(pool.capacity()) {
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    LeakWatchdog(const LeakWatchdog&) = delete;
+    LeakWatchdog& operator=(const LeakWatchdog&) = delete;
+
+    ~LeakWatchdog() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+    static void printToStderr(const HeldMessage& held) {
+        std::fprintf(stderr, "message_pool: slot %zu held for %lld ms by thread %llu",
+                     held.index,
+                     static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(held.heldFor).count()),
+                     static_cast<unsigned long long>(held.ownerThread));
+        if (held.site.file) {
+            std::fprintf(stderr, " (borrowed at %s:%d)", held.site.file, held.site.line);
+        }
+        std::fputc('\n', stderr);
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!cv_.wait_for(lock, interval_, [this]() { return stop_; })) {
+            lock.unlock();
+            scan();
+            lock.lock();
+        }
+    }
+
+    void scan() {
+        for (const HeldMessage& held : pool_.heldLongerThan(threshold_)) {
+            // The same borrow shows up on every scan until it is released
+            if (reported_[held.index] == held.borrowTicks) continue;
+            reported_[held.index] = held.borrowTicks;
+            reporter_(held);
+        }
+    }
+
+    const MessagePool& pool_;
+    std::chrono::nanoseconds threshold_;
+    std::chrono::milliseconds interval_;
+    Reporter reporter_;
+    std::vector<uint64_t> reported_; // Borrow ticks last reported, per slot
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+};
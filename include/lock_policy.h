@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Locking policies for BasicMessagePool. Each names the mutex guarding the
+// pool state, the condition variable blocked borrowers sleep on, and the
+// counter type behind the pool's statistics and histograms.
+
+// Default: std::mutex, blocking waits.
+struct MutexLock {
+    using Mutex = std::mutex;
+    using CondVar = std::condition_variable;
+    template <class T>
+    using Counter = std::atomic<T>;
+};
+
+// Test-and-test-and-set spinlock for short critical sections on cores that
+// aren't oversubscribed. Exhausted borrowers still sleep.
+class SpinMutex {
+public:
+    void lock() {
+        while (locked_.exchange(true, std::memory_order_acquire)) {
+            while (locked_.load(std::memory_order_relaxed)) relax();
+        }
+    }
+
+    bool try_lock() {
+        return !locked_.load(std::memory_order_relaxed) && !locked_.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() { locked_.store(false, std::memory_order_release); }
+
+private:
+    static void relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    std::atomic<bool> locked_{false};
+};
+
+struct SpinLock {
+    using Mutex = SpinMutex;
+    using CondVar = std::condition_variable_any;
+    template <class T>
+    using Counter = std::atomic<T>;
+};
+
+// For pools confined to one thread: locking compiles away. No other thread
+// can release while the owner waits, so an exhausted borrow fails at once
+// instead of sleeping out the timeout.
+class NullMutex {
+public:
+    void lock() {}
+    bool try_lock() { return true; }
+    void unlock() {}
+};
+
+class NullCondVar {
+public:
+    template <class Lock, class Rep, class Period, class Predicate>
+    bool wait_for(Lock&, const std::chrono::duration<Rep, Period>&, Predicate ready) {
+        return ready();
+    }
+
+    void notify_one() {}
+    void notify_all() {}
+};
+
+// The part of std::atomic's interface the pool's counters use, on a plain
+// integer: updates are ordinary adds rather than locked read-modify-writes.
+template <class T>
+class PlainCounter {
+public:
+    constexpr PlainCounter(T value = T()) : value_(value) {}
+
+    T load(std::memory_order = std::memory_order_seq_cst) const { return value_; }
+    void store(T value, std::memory_order = std::memory_order_seq_cst) { value_ = value; }
+
+    T fetch_add(T n, std::memory_order = std::memory_order_seq_cst) {
+        T old = value_;
+        value_ += n;
+        return old;
+    }
+
+private:
+    T value_;
+};
+
+// Besides the lock, plain counters replace the atomic ones, and releases
+// check a slot's state with a load and a store instead of a compare-and-swap.
+// Borrows and releases are still timestamped for the hold-time histogram and
+// heldLongerThan(). Statistics must be read on the owning thread too.
+struct NoLock {
+    using Mutex = NullMutex;
+    using CondVar = NullCondVar;
+    template <class T>
+    using Counter = PlainCounter<T>;
+};
@@ -1,67 +1,1549 @@
+#pragma once
+
+#include "pool_stats.h"
+#include "latency_histogram.h"
+#include "cycle_clock.h"
+#include "pool_trace.h"
+#include "event_recorder.h"
+#include "stop_token.h"
+#include "lock_policy.h"
+#include <atomic>
+#include <functional>
 #include <vector>
+#include <algorithm>
 #include <memory>
 #include <mutex>
 #include <condition_variable>
 #include <stdexcept>
 #include <chrono>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <thread>
+#include <type_traits>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+// Debug builds remember where each message was borrowed from; release builds
+// compile the call site down to nothing.
+#ifndef MESSAGE_POOL_TRACK_CALLSITES
+#ifdef NDEBUG
+#define MESSAGE_POOL_TRACK_CALLSITES 0
+#else
+#define MESSAGE_POOL_TRACK_CALLSITES 1
+#endif
+#endif
+
+// Checked builds (debug by default) put a guard zone after every slot and
+// fill free payloads with a poison pattern: release() verifies the guard
+// zone's canary, borrows verify the poison. Under AddressSanitizer the guard
+// zones and free payloads are poisoned instead, so a stray access is
+// reported where it happens. Release builds compile all of it out.
+#ifndef MESSAGE_POOL_CHECKED
+#ifdef NDEBUG
+#define MESSAGE_POOL_CHECKED 0
+#else
+#define MESSAGE_POOL_CHECKED 1
+#endif
+#endif
+
+#if defined(__SANITIZE_ADDRESS__)
+#define MESSAGE_POOL_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define MESSAGE_POOL_ASAN 1
+#endif
+#endif
+#ifdef MESSAGE_POOL_ASAN
+#include <sanitizer/asan_interface.h>
+#endif
 
 struct NetworkMessage {
-    int id;         // Used by pool for tracking
-    char data[256]; // Actual message payload
+    int id;             // Slot index, set on borrow
+    uint16_t length;    // Live bytes in data
+    uint16_t type;      // Application-defined message type
+    uint64_t sequence;  // Producer sequence number
+    uint64_t timestamp; // Receive time, nanoseconds since the epoch
+    char data[256];     // Actual message payload
+};
+
+// Copies header and live payload bytes only; dst keeps its own pool id.
+// Throws, leaving dst untouched, if src claims more bytes than it holds.
+inline void copyMessage(NetworkMessage* dst, const NetworkMessage* src) {
+    if (src->length > sizeof(src->data)) {
+        throw std::runtime_error("Invalid message length");
+    }
+    dst->length = src->length;
+    dst->type = src->type;
+    dst->sequence = src->sequence;
+    dst->timestamp = src->timestamp;
+    std::memcpy(dst->data, src->data, src->length);
+}
+
+#if MESSAGE_POOL_TRACK_CALLSITES
+struct CallSite {
+    const char* file = nullptr;
+    int line = 0;
+
+    // As a default argument, captures the caller's location.
+    static CallSite current(const char* file = __builtin_FILE(), int line = __builtin_LINE()) {
+        return {file, line};
+    }
+};
+#else
+struct CallSite {
+    static constexpr const char* file = nullptr;
+    static constexpr int line = 0;
+
+    static CallSite current() { return {}; }
+};
+#endif
+
+// A borrowed message as seen by the long-hold detector.
+struct HeldMessage {
+    NetworkMessage* msg;
+    size_t index;
+    std::chrono::nanoseconds heldFor;
+    uint64_t borrowTicks; // CycleClock time of the borrow; identifies it across scans
+    uint64_t ownerThread; // Kernel thread id of the borrower, 0 if unknown
+    CallSite site;        // Where it was borrowed (debug builds only)
+};
+
+// Free-slot watermark crossings. Low fires when the free count falls to the
+// low watermark, High when it climbs back to the high watermark afterwards.
+enum class Watermark { Low, High };
+
+// Borrow priority. Reserved slots go only to High; when a slot frees up,
+// waiters are woken highest class first.
+enum class Priority : uint8_t { Low = 0, Normal = 1, High = 2 };
+
+// Which free slot a borrow takes. Fifo hands out the slot released longest
+// ago, spreading wear and keeping a just-released message untouched for a
+// while; Lifo hands out the most recently released one, which is likely
+// still in this core's cache.
+enum class ReuseOrder { Fifo, Lifo };
+
+// Speculative prefetch-for-write of slots about to be handed out. Next warms
+// the slot the following borrow will take; Batch also warms a batch's slots
+// before claiming them, so their misses overlap instead of queuing behind
+// the caller's first writes.
+enum class Prefetch { Off, Next, Batch };
+
+// Zeroing of message payloads so one borrower never sees another's data.
+// OnRelease scrubs in the releasing thread, OnBorrow just before a slot is
+// handed out, Background on a pool-owned thread before the slot rejoins the
+// free list. On x86 whole slot lines are written with non-temporal stores,
+// so a scrub doesn't pull cold slots into the cache over the caller's data.
+// The stores must drain before a slot is published again, a stall of a few
+// hundred nanoseconds that a lone release() or borrow() pays per message and
+// batches and the Background scrubber pay once per batch. Where slots stay
+// cached anyway a memset is cheaper; `message_pool_bench scrub` compares.
+enum class Scrub { Off, OnRelease, OnBorrow, Background };
+
+// Per-priority borrow counters.
+struct PriorityStats {
+    uint64_t borrows = 0;
+    uint64_t waits = 0;
+    uint64_t timeouts = 0;
 };
 
-class MessagePool {
+// Layout of the pool region: this header, one state byte per slot, then the
+// slots themselves. The same layout backs both anonymous and file-backed pools.
+struct PoolFileHeader {
+    static constexpr uint64_t kMagic = 0x004c4f4f5047534dULL; // "MSGPOOL"
+    static constexpr uint32_t kVersion = 2;
+
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slotSize;
+    uint64_t capacity;
+};
+
+template <class Executor>
+class BorrowAwaiter;
+
+// Process-unique pool numbers, shared by every locking policy.
+inline uint32_t nextMessagePoolId() {
+    static std::atomic<uint32_t> next{0};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+// The pool, parameterised on its locking policy (lock_policy.h). Use the
+// MessagePool alias unless a pool is confined to one thread (NoLock) or its
+// critical sections are short enough to spin on (SpinLock).
+template <class LockPolicy>
+class BasicMessagePool {
 public:
-    explicit MessagePool(size_t poolSize, std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
-        : poolSize_(poolSize), timeout_(timeout) {
-        storage_.reserve(poolSize_);
-        for (size_t i = 0; i < poolSize_; ++i) {
-            auto msg = std::make_unique<NetworkMessage>();
-            msg->id = static_cast<int>(i);
-            storage_.push_back(std::move(msg));
-            freeList_.push_back(i);
+    using Mutex = typename LockPolicy::Mutex;
+    using CondVar = typename LockPolicy::CondVar;
+
+    // Runs with the pool lock held: keep it short and don't call into the pool.
+    using WatermarkCallback = std::function<void(Watermark, size_t freeCount)>;
+
+    explicit BasicMessagePool(size_t poolSize, std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
+        : poolSize_(poolSize), timeout_(timeout), stats_(poolSize), slotInfo_(poolSize),
+          remoteNext_(new uint32_t[poolSize]) {
+        CycleClock::nanosPerTick();
+        mapRegion(-1);
+        initialize();
+    }
+
+    // File-backed pool: creates the file if needed, otherwise re-attaches to it.
+    // Slots that were borrowed when the previous owner went away stay borrowed
+    // and are reported by recovered(); the caller owns them and must release them.
+    // The file is locked for the pool's lifetime: a second pool on it, in this
+    // process or another, throws instead of sharing the slots.
+    BasicMessagePool(const std::string& backingFile, size_t poolSize,
+                std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
+        : poolSize_(poolSize), timeout_(timeout), stats_(poolSize), slotInfo_(poolSize),
+          remoteNext_(new uint32_t[poolSize]) {
+        CycleClock::nanosPerTick();
+        int fd = ::open(backingFile.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open backing file: " + backingFile);
+        }
+
+        try {
+            if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+                throw std::runtime_error("Backing file is in use by another pool: " + backingFile);
+            }
+
+            struct stat st;
+            if (::fstat(fd, &st) != 0) {
+                throw std::runtime_error("Failed to stat backing file: " + backingFile);
+            }
+
+            bool fresh = st.st_size == 0;
+            if (fresh && ::ftruncate(fd, static_cast<off_t>(regionSize())) != 0) {
+                throw std::runtime_error("Failed to size backing file: " + backingFile);
+            }
+            if (!fresh && static_cast<size_t>(st.st_size) != regionSize()) {
+                throw std::runtime_error("Backing file does not match pool layout");
+            }
+
+            mapRegion(fd);
+            // No magic yet: a previous creator died before finishing initialize()
+            if (fresh || header_->magic == 0) {
+                initialize();
+            } else {
+                attach();
+            }
+        } catch (...) {
+            ::close(fd);
+            throw;
         }
+        lockFd_ = fd;
     }
 
-    NetworkMessage* borrow() {
-        std::unique_lock<std::mutex> lock(mutex_);
+    BasicMessagePool(const BasicMessagePool&) = delete;
+    BasicMessagePool& operator=(const BasicMessagePool&) = delete;
 
-        // Wait until a message becomes available
-        if (!cv_.wait_for(lock, timeout_, [this]() { return !freeList_.empty(); })) {
-            throw std::runtime_error("Timeout waiting for available message");
+    ~BasicMessagePool() {
+        stopScrubber();
+        if (watermarkFd_ >= 0) ::close(watermarkFd_);
+        if (availableFd_ >= 0) ::close(availableFd_);
+#ifdef MESSAGE_POOL_ASAN
+        ASAN_UNPOISON_MEMORY_REGION(region_, regionSize()); // The address range may be reused
+#endif
+        ::munmap(region_, regionSize());
+        if (lockFd_ >= 0) ::close(lockFd_);
+    }
+
+    NetworkMessage* borrow(CallSite site = CallSite::current()) {
+        return borrow(Priority::Normal, site);
+    }
+
+    NetworkMessage* borrow(Priority priority, CallSite site = CallSite::current()) {
+        return borrowOne(priority, site, nullptr);
+    }
+
+    // Like borrow(), but a stop requested on token wakes the wait early with
+    // a "Borrow cancelled" error.
+    NetworkMessage* borrow(const StopToken& token, Priority priority = Priority::Normal,
+                           CallSite site = CallSite::current()) {
+        // Registered outside the pool lock: the callback takes it
+        StopCallback interrupt(token, [this]() { wakeAll(); });
+        return borrowOne(priority, site, &token);
+    }
+
+    // Non-blocking borrow: nullptr instead of waiting when no slot is free
+    // to this priority.
+    NetworkMessage* tryBorrow(Priority priority = Priority::Normal, CallSite site = CallSite::current()) {
+        std::unique_lock<Mutex> lock(mutex_);
+        reclaimOwnRemote();
+        if (!shutdown_ && mustWait(priority)) reclaimAllRemote();
+        if (shutdown_ || mustWait(priority)) return nullptr;
+        NetworkMessage* msg = borrowSlot(takeFree(), priority, site);
+        lock.unlock();
+        scrubBorrowed(&msg, 1);
+        return msg;
+    }
+
+    // Borrows up to count messages under a single lock acquisition. Waits like
+    // borrow() until at least one is free, then returns how many were taken.
+    size_t borrowBatch(NetworkMessage** out, size_t count, CallSite site = CallSite::current()) {
+        return borrowBatch(out, count, Priority::Normal, site);
+    }
+
+    size_t borrowBatch(NetworkMessage** out, size_t count, Priority priority,
+                       CallSite site = CallSite::current()) {
+        if (count == 0) return 0;
+
+        MESSAGE_POOL_PROBE1(borrow__entry, poolId_);
+        std::unique_lock<Mutex> lock(mutex_);
+        if (shutdown_) throw std::runtime_error("Message pool is shut down");
+        reclaimOwnRemote();
+
+        size_t handed = kNoSlot;
+        bool waited = mustWait(priority);
+        if (waited) {
+            handed = waitForFree(lock, priority, nullptr);
         }
 
-        size_t index = freeList_.front();
-        freeList_.erase(freeList_.begin());
-        return storage_[index].get();
+        size_t taken = 0;
+        uint64_t now = CycleClock::now();
+        uint64_t owner = currentThreadId();
+        try {
+            if (handed != kNoSlot) {
+                out[taken] = claim(handed, now, owner, site);
+                ++taken;
+            }
+            size_t fromList = std::min(count - taken, takeable(priority));
+            if (prefetch_ == Prefetch::Batch) {
+                for (size_t i = 0; i < fromList; ++i) {
+                    size_t index = reuse_ == ReuseOrder::Lifo ? freeList_.at(freeList_.size() - 1 - i)
+                                                              : freeList_.at(i);
+                    prefetchForWrite(slotAt(index));
+                }
+            }
+            for (size_t i = 0; i < fromList; ++i) {
+                out[taken] = claim(takeFree(), now, owner, site);
+                ++taken;
+            }
+        } catch (...) {
+            // A corrupt slot (checked builds) stays out of circulation; the
+            // ones already claimed go back rather than leak
+            CondVar* wake = nullptr;
+            for (size_t i = 0; i < taken; ++i) {
+                if (CondVar* cv = freeSlot(slotIndex(out[i]))) wake = cv;
+            }
+            if (wake) wake->notify_all();
+            throw;
+        }
+        prefetchNext();
+        stats_.onBorrow(taken);
+        stats_.onFreeCount(freeList_.size());
+        priorities_[static_cast<size_t>(priority)].borrows.fetch_add(taken, std::memory_order_relaxed);
+        freeCountChanged();
+        if (waited) wakeNext();
+        lock.unlock();
+        scrubBorrowed(out, taken);
+        return taken;
     }
 
     void release(NetworkMessage* msg) {
         if (!msg) return;
+        size_t index = validate(msg);
+        Scrub scrub = scrub_.load(std::memory_order_relaxed);
+        if (scrub == Scrub::Background) {
+            releaseToScrubber(index);
+            return;
+        }
+        if (scrub == Scrub::OnRelease) {
+            scrubPayload(msg);
+            scrubFence();
+        }
+        if (remoteFree_.load(std::memory_order_relaxed) && releaseRemote(index)) return;
 
+        uint64_t heldTicks;
+        CondVar* wake = nullptr;
         {
-            std::lock_guard<std::mutex> lock(mutex_);
-            if (msg->id < 0 || static_cast<size_t>(msg->id) >= poolSize_) {
-                throw std::runtime_error("Invalid message ID");
+            std::lock_guard<Mutex> lock(mutex_);
+            heldTicks = CycleClock::now() - slotInfo_[index].borrowTicks;
+            // Recorded under the lock so it precedes the slot's next borrow
+            record(PoolEvent::Release, index);
+            wake = freeSlot(index);
+        }
+        MESSAGE_POOL_PROBE2(release, poolId_, index);
+
+        stats_.onRelease();
+        holdTime_.record(CycleClock::toNanos(heldTicks));
+        if (wake) wake->notify_one();
+    }
+
+    // All or nothing: if any message is invalid, or listed twice, none is
+    // released.
+    void releaseBatch(NetworkMessage* const* msgs, size_t count) {
+        if (count == 0) return;
+        for (size_t i = 0; i < count; ++i) {
+            try {
+                validate(msgs[i]);
+            } catch (...) {
+                while (i-- > 0) unmarkReleasing(slotIndex(msgs[i]));
+                throw;
             }
-            freeList_.push_back(static_cast<size_t>(msg->id));
         }
+        Scrub scrub = scrub_.load(std::memory_order_relaxed);
+        if (scrub == Scrub::Background || scrub == Scrub::OnRelease) {
+            if (scrub == Scrub::Background) {
+                for (size_t i = 0; i < count; ++i) {
+                    releaseToScrubber(slotIndex(msgs[i]));
+                }
+                return;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                scrubPayload(msgs[i]);
+            }
+            scrubFence();
+        }
+
+        CondVar* wake;
+        {
+            std::lock_guard<Mutex> lock(mutex_);
+            uint64_t now = CycleClock::now();
+            for (size_t i = 0; i < count; ++i) {
+                size_t index = slotIndex(msgs[i]);
+                holdTime_.record(CycleClock::toNanos(now - slotInfo_[index].borrowTicks));
+                MESSAGE_POOL_PROBE2(release, poolId_, index);
+                record(PoolEvent::Release, index);
+                freeSlot(index);
+            }
+            wake = nextToWake();
+        }
+
+        stats_.onRelease(count);
+        // Lower classes are woken in turn as each waiter leaves with slots to spare
+        if (wake) wake->notify_all();
+    }
+
+    // Fair mode queues blocked borrowers in arrival order (per priority) and
+    // hands each released slot straight to the longest waiter, so neither a
+    // newcomer nor a luckier waiter can take it first. Costs a wakeup per
+    // release under contention, in exchange for bounded waits.
+    void setFairWaiting(bool fair) {
+        std::lock_guard<Mutex> lock(mutex_);
+        fair_ = fair;
+    }
+
+    bool fairWaiting() const {
+        std::lock_guard<Mutex> lock(mutex_);
+        return fair_;
+    }
+
+    // Slots released while waiters are queued in fair mode go straight to
+    // them whatever the order; this only picks among free-list slots.
+    void setReuseOrder(ReuseOrder order) {
+        std::lock_guard<Mutex> lock(mutex_);
+        reuse_ = order;
+    }
+
+    ReuseOrder reuseOrder() const {
+        std::lock_guard<Mutex> lock(mutex_);
+        return reuse_;
+    }
+
+    // Off by default: the prefetch is wasted when the next slot is taken by
+    // another thread or the pool is small enough to stay cached anyway.
+    void setPrefetch(Prefetch mode) {
+        std::lock_guard<Mutex> lock(mutex_);
+        prefetch_ = mode;
+    }
 
-        cv_.notify_one();
+    Prefetch prefetch() const {
+        std::lock_guard<Mutex> lock(mutex_);
+        return prefetch_;
     }
 
+    // Remote-free mode: release() on a thread other than the borrower's
+    // pushes the slot onto a lock-free list owned by the borrowing thread
+    // instead of taking the pool lock; the owner folds the list back into
+    // the free list on its next borrow. Keeps a producer's borrows from
+    // contending with consumers' releases. While the pool runs short (free
+    // list empty, or under watermark pressure) or a borrower is blocked,
+    // remote releases return their slots at once instead, so availableFd(),
+    // watermarks and other threads' tryBorrow() don't depend on the owner
+    // borrowing again. Lists of owner threads that have exited are handed
+    // to new owners. Until reclaimed, such slots
+    // count as available() and no longer show up in heldLongerThan(). Only
+    // release() takes this path; releaseBatch() already amortises the lock.
+    // Toggle it while no releases are in flight; disabling reclaims everything.
+    void setRemoteFree(bool enabled) {
+        std::lock_guard<Mutex> lock(mutex_);
+        remoteFree_.store(enabled, std::memory_order_relaxed);
+        if (!enabled) reclaimAllRemote();
+    }
+
+    bool remoteFree() const { return remoteFree_.load(std::memory_order_relaxed); }
+
+    // Off by default. Background starts a scrubber thread, which drains its
+    // queue and exits when the mode changes or the pool is destroyed; slots
+    // waiting for it count as available() and are left out of heldLongerThan().
+    // Not for single-threaded pools. Change the mode while nothing is being
+    // released.
+    void setScrub(Scrub mode) {
+        if (mode == Scrub::Background && kConfined) {
+            throw std::runtime_error("Background scrubbing needs a thread-safe pool");
+        }
+        if (mode != Scrub::Background) stopScrubber();
+        scrub_.store(mode, std::memory_order_relaxed);
+        if (mode == Scrub::Background && !scrubber_.joinable()) {
+            scrubStop_ = false;
+            dirty_.reserve(poolSize_); // Releases never allocate
+            scrubber_ = std::thread([this]() { scrubLoop(); });
+        }
+    }
+
+    Scrub scrub() const { return scrub_.load(std::memory_order_relaxed); }
+
     size_t available() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return freeList_.size();
+        std::lock_guard<Mutex> lock(mutex_);
+        return freeList_.size() + parkedSlots() + scrubPending_.load(std::memory_order_relaxed);
     }
 
     size_t capacity() const { return poolSize_; }
 
+    // Bytes a pool of the given capacity occupies: the mapped region plus
+    // per-slot bookkeeping and free list.
+    static size_t footprint(size_t capacity) {
+        size_t slots = alignUp(alignUp(sizeof(PoolFileHeader), 64) + capacity, 64);
+        return slots + capacity * (kSlotStride + sizeof(SlotInfo) + sizeof(size_t) + sizeof(uint32_t));
+    }
+
+    // Starts (or with nullptr stops) recording borrow/release events. The
+    // recorder must outlive the pool or be detached first.
+    void setRecorder(EventRecorder* recorder) { recorder_.store(recorder, std::memory_order_release); }
+
+    // Holds back the last `slots` free slots for Priority::High borrowers:
+    // Normal and Low callers wait once only that many remain.
+    void reserveForHighPriority(size_t slots) {
+        if (slots > poolSize_) {
+            throw std::runtime_error("Cannot reserve more slots than the pool holds");
+        }
+        CondVar* wake;
+        {
+            std::lock_guard<Mutex> lock(mutex_);
+            reserved_ = slots;
+            // Shrinking the reserve can unblock waiters
+            while (!freeList_.empty()) {
+                Waiter* waiter = nextQueued(freeList_.size() - 1);
+                if (!waiter) break;
+                handOff(waiter, takeFree());
+            }
+            freeCountChanged();
+            wake = nextToWake();
+        }
+        if (wake) wake->notify_all();
+    }
+
+    size_t reservedForHighPriority() const {
+        std::lock_guard<Mutex> lock(mutex_);
+        return reserved_;
+    }
+
+    PriorityStats priorityStats(Priority priority) const {
+        const PriorityClass& cls = priorities_[static_cast<size_t>(priority)];
+        PriorityStats out;
+        out.borrows = cls.borrows.load(std::memory_order_relaxed);
+        out.waits = cls.waits.load(std::memory_order_relaxed);
+        out.timeouts = cls.timeouts.load(std::memory_order_relaxed);
+        return out;
+    }
+
+    // Fails every blocked and future borrow with "Message pool is shut down"
+    // (tryBorrow() returns nullptr) so threads stop waiting at once. Messages
+    // already out can still be released. Irreversible.
+    void shutdown() {
+        std::lock_guard<Mutex> lock(mutex_);
+        shutdown_ = true;
+        for (PriorityClass& cls : priorities_) {
+            cls.cv.notify_all();
+            while (Waiter* waiter = cls.head) {
+                unlink(waiter);
+                waiter->cancelled = true;
+                if (waiter->resume) {
+                    waiter->resume(waiter);
+                } else {
+                    waiter->cv.notify_one();
+                }
+            }
+        }
+    }
+
+    bool isShutdown() const {
+        std::lock_guard<Mutex> lock(mutex_);
+        return shutdown_;
+    }
+
+    // Signals when free slots run low so producers can throttle or shed load
+    // before borrows start blocking. Edge-triggered with hysteresis: Low fires
+    // once when the free count drops to low, High once when it recovers to
+    // high. Each crossing also bumps watermarkFd(). Fires immediately if the
+    // pool is already at or below low.
+    void setWatermarks(size_t low, size_t high, WatermarkCallback callback = nullptr) {
+        if (low >= high || high > poolSize_) {
+            throw std::runtime_error("Watermarks must satisfy low < high <= capacity");
+        }
+        std::lock_guard<Mutex> lock(mutex_);
+        if (watermarkFd_ < 0) {
+            watermarkFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (watermarkFd_ < 0) {
+                throw std::runtime_error("Failed to create watermark eventfd");
+            }
+        }
+        lowWatermark_ = low;
+        highWatermark_ = high;
+        watermarkCallback_ = std::move(callback);
+        watermarksSet_ = true;
+        underPressure_.store(false, std::memory_order_relaxed);
+        freeCountChanged();
+    }
+
+    // Non-blocking eventfd that becomes readable on every watermark crossing,
+    // for poll/epoll loops; read it to rearm, then check underPressure().
+    // -1 until setWatermarks() is called.
+    int watermarkFd() const {
+        std::lock_guard<Mutex> lock(mutex_);
+        return watermarkFd_;
+    }
+
+    // True between a Low crossing and the following High one. Lock-free.
+    bool underPressure() const { return underPressure_.load(std::memory_order_relaxed); }
+
+    // Non-blocking eventfd that is readable while a Normal-priority
+    // tryBorrow() would get a slot, so an epoll loop can stop reading input
+    // when the pool runs dry and resume once it refills. Slots held back by
+    // reserveForHighPriority() don't count. Created on first call; owned by
+    // the pool.
+    int availableFd() {
+        std::lock_guard<Mutex> lock(mutex_);
+        if (availableFd_ < 0) {
+            availableFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (availableFd_ < 0) {
+                throw std::runtime_error("Failed to create availability eventfd");
+            }
+            updateAvailableFd();
+        }
+        return availableFd_;
+    }
+
+    // Process-unique pool number, carried by every trace probe.
+    uint32_t id() const { return poolId_; }
+
+    // Aggregated counters; safe to call from a monitoring thread at any rate
+    // since it never takes the pool lock.
+    PoolStatsSnapshot stats() const { return stats_.snapshot(); }
+
+    // Nanoseconds spent blocked in borrow(), one sample per wait.
+    HistogramSnapshot waitHistogram() const { return waitTime_.snapshot(); }
+
+    // Nanoseconds between borrow and release, one sample per message.
+    HistogramSnapshot holdHistogram() const { return holdTime_.snapshot(); }
+
+    // Start of the slot array: capacity() slots, slotStride() bytes apart
+    // (a NetworkMessage rounded up to whole cache lines, plus a guard zone in
+    // checked builds). Lets I/O backends
+    // register the whole pool with the kernel up front.
+    NetworkMessage* slab() const { return slots_; }
+
+    static constexpr size_t slotStride() { return kSlotStride; }
+
+    // True for pools mapped from a backing file rather than anonymous memory.
+    bool fileBacked() const { return lockFd_ >= 0; }
+
+    NetworkMessage* slotAt(size_t index) const {
+        return reinterpret_cast<NetworkMessage*>(reinterpret_cast<char*>(slots_) + index * kSlotStride);
+    }
+
+    // Borrowed messages held for longer than threshold, longest first.
+    std::vector<HeldMessage> heldLongerThan(std::chrono::nanoseconds threshold) const {
+        std::vector<HeldMessage> held;
+        std::lock_guard<Mutex> lock(mutex_);
+        uint64_t now = CycleClock::now();
+        for (size_t i = 0; i < poolSize_; ++i) {
+            if (stateOf(i) != kBorrowed) continue;
+            const SlotInfo& info = slotInfo_[i];
+            std::chrono::nanoseconds heldFor(CycleClock::toNanos(now - info.borrowTicks));
+            if (heldFor > threshold) {
+                held.push_back({slotAt(i), i, heldFor, info.borrowTicks, info.owner, info.site});
+            }
+        }
+        std::sort(held.begin(), held.end(), [](const HeldMessage& a, const HeldMessage& b) {
+            return a.heldFor > b.heldFor;
+        });
+        return held;
+    }
+
+    // Messages found in flight when a file-backed pool was re-attached.
+    const std::vector<NetworkMessage*>& recovered() const { return recovered_; }
+
 private:
+    template <class Executor>
+    friend class BorrowAwaiter;
+
+    // NoLock pools are used from one thread only
+    static constexpr bool kConfined = std::is_same<LockPolicy, NoLock>::value;
+
+    template <class T>
+    using Counter = typename LockPolicy::template Counter<T>;
+
+    static constexpr uint8_t kFree = 0;
+    static constexpr uint8_t kBorrowed = 1;
+    static constexpr uint8_t kReleasing = 2; // Released, not yet back on the free list
+
+    // Slots start on cache lines, so neighbours never share one and a scrub
+    // can stream whole lines. Checked builds add at least 32 guard bytes.
+#if MESSAGE_POOL_CHECKED
+    static constexpr size_t kSlotStride = (sizeof(NetworkMessage) + 32 + 63) / 64 * 64;
+#else
+    static constexpr size_t kSlotStride = (sizeof(NetworkMessage) + 63) / 64 * 64;
+#endif
+    static constexpr size_t kGuardSize = kSlotStride - sizeof(NetworkMessage);
+    static constexpr unsigned char kCanary = 0xfd;
+    static constexpr unsigned char kPoison = 0xdd;
+
+    static constexpr size_t kPriorities = 3;
+    static constexpr size_t kNoSlot = static_cast<size_t>(-1);
+    static constexpr size_t kMaxRemoteOwners = 16;
+    static constexpr uint16_t kNoRemoteList = 0xffff;
+    static constexpr uint32_t kRemoteEmpty = 0xffffffff;
+
+    // Free slot indices, oldest release at the front. A fixed ring so both
+    // ends pop in O(1) without allocating.
+    class SlotRing {
+    public:
+        void reserve(size_t capacity) {
+            slots_.reset(new size_t[capacity]);
+            capacity_ = capacity;
+        }
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        size_t front() const { return slots_[head_]; }
+        size_t at(size_t i) const { return slots_[wrap(head_ + i)]; }
+        size_t back() const { return slots_[wrap(head_ + size_ - 1)]; }
+
+        void push_back(size_t index) { slots_[wrap(head_ + size_++)] = index; }
+
+        void pop_front() {
+            head_ = wrap(head_ + 1);
+            --size_;
+        }
+
+        void pop_back() { --size_; }
+
+    private:
+        size_t wrap(size_t i) const { return i < capacity_ ? i : i - capacity_; }
+
+        std::unique_ptr<size_t[]> slots_;
+        size_t capacity_ = 0;
+        size_t head_ = 0;
+        size_t size_ = 0;
+    };
+
+    // Slots released by other threads on behalf of one borrowing thread: a
+    // lock-free stack linked through remoteNext_, drained whole by the owner.
+    struct RemoteList {
+        alignas(64) std::atomic<uint32_t> head{kRemoteEmpty};
+        std::atomic<size_t> pending{0};
+        uint64_t owner = 0; // Guarded by mutex_
+    };
+
+    // A borrower queued in fair mode; lives on the waiting thread's stack,
+    // or in the coroutine frame for asyncBorrow().
+    struct Waiter {
+        CondVar cv;
+        size_t slot = kNoSlot; // Set by the release that hands a slot over
+        size_t priority = 0;
+        bool cancelled = false; // Dequeued by shutdown() without a slot
+        Waiter* prev = nullptr;
+        Waiter* next = nullptr;
+        void (*resume)(Waiter*) = nullptr; // Async waiters are scheduled instead of notified
+    };
+
+    // Waiters and counters for one priority; each class sleeps on its own
+    // condition variable so releases can pick which class to wake. Fair-mode
+    // waiters queue on the intrusive list instead.
+    struct PriorityClass {
+        CondVar cv;
+        size_t waiting = 0; // Guarded by mutex_, as are head and tail
+        Waiter* head = nullptr;
+        Waiter* tail = nullptr;
+        Counter<uint64_t> borrows{0};
+        Counter<uint64_t> waits{0};
+        Counter<uint64_t> timeouts{0};
+    };
+
+    size_t reservedFor(Priority priority) const { return priority == Priority::High ? 0 : reserved_; }
+
+    // borrow() with an optional stop token.
+    NetworkMessage* borrowOne(Priority priority, CallSite site, const StopToken* token) {
+        MESSAGE_POOL_PROBE1(borrow__entry, poolId_);
+        std::unique_lock<Mutex> lock(mutex_);
+        if (shutdown_) throw std::runtime_error("Message pool is shut down");
+        reclaimOwnRemote();
+
+        // Wait until a message becomes available to this priority
+        size_t index = kNoSlot;
+        bool waited = mustWait(priority);
+        if (waited) {
+            index = waitForFree(lock, priority, token);
+        }
+        if (index == kNoSlot) { // Not handed over by a release
+            index = takeFree();
+        }
+
+        NetworkMessage* msg = borrowSlot(index, priority, site);
+        if (waited) wakeNext();
+        lock.unlock();
+        scrubBorrowed(&msg, 1);
+        return msg;
+    }
+
+    // Pops the next free slot in the pool's reuse order. The list must not
+    // be empty.
+    size_t takeFree() {
+        size_t index;
+        if (reuse_ == ReuseOrder::Lifo) {
+            index = freeList_.back();
+            freeList_.pop_back();
+        } else {
+            index = freeList_.front();
+            freeList_.pop_front();
+        }
+        return index;
+    }
+
+    // Free-list slots this priority may take right now.
+    size_t takeable(Priority priority) const {
+        size_t reserved = reservedFor(priority);
+        return freeList_.size() > reserved ? freeList_.size() - reserved : 0;
+    }
+
+    bool canTake(Priority priority) const { return takeable(priority) > 0; }
+
+    // A borrower waits if it can't take a slot, or if fair-mode waiters of
+    // the same or higher priority are already queued ahead of it.
+    bool mustWait(Priority priority) const {
+        if (!canTake(priority)) return true;
+        if (queued_ == 0) return false;
+        for (size_t i = static_cast<size_t>(priority); i < kPriorities; ++i) {
+            if (priorities_[i].head) return true;
+        }
+        return false;
+    }
+
+    // Longest-queued waiter of the highest class that may have a slot,
+    // given how many would stay on the free list.
+    Waiter* nextQueued(size_t freeAfter) const {
+        if (queued_ == 0) return nullptr;
+        for (size_t i = kPriorities; i-- > 0;) {
+            if (priorities_[i].head && freeAfter >= reservedFor(static_cast<Priority>(i))) {
+                return priorities_[i].head;
+            }
+        }
+        return nullptr;
+    }
+
+    void enqueue(Waiter* waiter) {
+        PriorityClass& cls = priorities_[waiter->priority];
+        waiter->prev = cls.tail;
+        (cls.tail ? cls.tail->next : cls.head) = waiter;
+        cls.tail = waiter;
+        ++queued_;
+        blocked_.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    void unlink(Waiter* waiter) {
+        PriorityClass& cls = priorities_[waiter->priority];
+        (waiter->prev ? waiter->prev->next : cls.head) = waiter->next;
+        (waiter->next ? waiter->next->prev : cls.tail) = waiter->prev;
+        --queued_;
+        blocked_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Lock-free release from a thread that didn't borrow the message. False
+    // if it must go through the lock instead.
+    bool releaseRemote(size_t index) {
+        const SlotInfo& info = slotInfo_[index];
+        if (info.remoteList == kNoRemoteList || info.owner == currentThreadId()) return false;
+
+        RemoteList& list = remote_[info.remoteList];
+        uint64_t heldTicks = CycleClock::now() - info.borrowTicks;
+        record(PoolEvent::Release, index);
+        list.pending.fetch_add(1, std::memory_order_relaxed);
+        uint32_t head = list.head.load(std::memory_order_relaxed);
+        do {
+            remoteNext_[index] = head;
+        } while (!list.head.compare_exchange_weak(head, static_cast<uint32_t>(index), std::memory_order_seq_cst,
+                                                  std::memory_order_relaxed));
+        MESSAGE_POOL_PROBE2(release, poolId_, index);
+        stats_.onRelease();
+        holdTime_.record(CycleClock::toNanos(heldTicks));
+
+        // Pairs with the waiter's count-then-reclaim and updateLean()'s
+        // flag-then-reclaim: either they saw this slot, or this sees them and
+        // returns the slot under the lock.
+        if (blocked_.load(std::memory_order_seq_cst) > 0 || lean_.load(std::memory_order_seq_cst)) {
+            std::lock_guard<Mutex> lock(mutex_);
+            reclaimAllRemote();
+        }
+        return true;
+    }
+
+    // The caller's remote list, registering it on first use. Once all
+    // kMaxRemoteOwners lists are taken, a new thread gets the list of one
+    // that has exited, or else falls back to locked releases.
+    uint16_t remoteListFor(uint64_t owner) {
+        struct Cache {
+            uint32_t pool = 0xffffffff;
+            uint16_t list = kNoRemoteList;
+        };
+        thread_local Cache cache;
+        if (cache.pool == poolId_) return cache.list;
+
+        uint16_t list = kNoRemoteList;
+        for (size_t i = 0; i < remoteOwners_; ++i) {
+            if (remote_[i].owner == owner) list = static_cast<uint16_t>(i);
+        }
+        if (list == kNoRemoteList && remoteOwners_ < kMaxRemoteOwners) {
+            remote_[remoteOwners_].owner = owner;
+            list = static_cast<uint16_t>(remoteOwners_++);
+        }
+        if (list == kNoRemoteList) list = recycleRemoteList(owner);
+        cache = {poolId_, list};
+        return list;
+    }
+
+    // Returns the parked slots of an owner thread that no longer exists and
+    // gives its list to owner. Slots it still holds keep pointing at the
+    // list; their releases are reclaimed by the new owner.
+    uint16_t recycleRemoteList(uint64_t owner) {
+        pid_t pid = ::getpid();
+        for (size_t i = 0; i < remoteOwners_; ++i) {
+            long alive = ::syscall(SYS_tgkill, pid, static_cast<pid_t>(remote_[i].owner), 0);
+            if (alive != 0 && errno == ESRCH) {
+                reclaimRemote(remote_[i]);
+                remote_[i].owner = owner;
+                return static_cast<uint16_t>(i);
+            }
+        }
+        return kNoRemoteList;
+    }
+
+    // Returns every slot on one remote list to the pool, under the lock.
+    void reclaimRemote(RemoteList& list) {
+        uint32_t index = list.head.exchange(kRemoteEmpty, std::memory_order_acquire);
+        if (index == kRemoteEmpty) return;
+
+        // Each slot leaves the pending count before it joins the free list,
+        // so the watermark checks freeSlot() runs never count it twice
+        CondVar* wake = nullptr;
+        while (index != kRemoteEmpty) {
+            uint32_t next = remoteNext_[index];
+            list.pending.fetch_sub(1, std::memory_order_relaxed);
+            if (CondVar* cv = freeSlot(index)) wake = cv;
+            index = next;
+        }
+        if (wake) wake->notify_all();
+    }
+
+    // Slots parked on remote-free lists. Free as far as borrowers are
+    // concerned: a borrow that finds the free list short sweeps them back.
+    size_t parkedSlots() const {
+        size_t parked = 0;
+        for (size_t i = 0; i < remoteOwners_; ++i) {
+            parked += remote_[i].pending.load(std::memory_order_relaxed);
+        }
+        return parked;
+    }
+
+    void reclaimOwnRemote() {
+        if (!remoteFree_.load(std::memory_order_relaxed)) return;
+        uint16_t list = remoteListFor(currentThreadId());
+        if (list != kNoRemoteList && remote_[list].head.load(std::memory_order_relaxed) != kRemoteEmpty) {
+            reclaimRemote(remote_[list]);
+        }
+    }
+
+    void reclaimAllRemote() {
+        for (size_t i = 0; i < remoteOwners_; ++i) {
+            reclaimRemote(remote_[i]);
+        }
+    }
+
+    // Notified under the lock: once it is dropped the waiter may return and
+    // take its condition variable with it.
+    void handOff(Waiter* waiter, size_t index) {
+        unlink(waiter);
+        waiter->slot = index;
+        if (waiter->resume) {
+            waiter->resume(waiter);
+        } else {
+            waiter->cv.notify_one();
+        }
+    }
+
+    // Returns a slot to the next queued waiter or the free list. The caller
+    // notifies the returned condition variable, if any, after unlocking.
+    CondVar* freeSlot(size_t index) {
+        setState(index, kFree);
+        poisonPayload(index);
+        if (Waiter* waiter = nextQueued(freeList_.size())) {
+            handOff(waiter, index);
+            return nullptr;
+        }
+        freeList_.push_back(index);
+        freeCountChanged();
+        return nextToWake();
+    }
+
+    // Single-slot borrow bookkeeping, under the lock.
+    NetworkMessage* borrowSlot(size_t index, Priority priority, CallSite site) {
+        NetworkMessage* msg = claim(index, CycleClock::now(), currentThreadId(), site);
+        prefetchNext();
+        stats_.onBorrow();
+        stats_.onFreeCount(freeList_.size());
+        priorities_[static_cast<size_t>(priority)].borrows.fetch_add(1, std::memory_order_relaxed);
+        freeCountChanged();
+        return msg;
+    }
+
+    // Marks a slot borrowed by the caller and returns it ready for use.
+    NetworkMessage* claim(size_t index, uint64_t now, uint64_t owner, CallSite site) {
+        checkPoison(index);
+        setState(index, kBorrowed);
+        uint16_t remoteList = remoteFree_.load(std::memory_order_relaxed) ? remoteListFor(owner) : kNoRemoteList;
+        slotInfo_[index] = {now, owner, site, remoteList};
+        NetworkMessage* msg = slotAt(index);
+        msg->id = static_cast<int>(index); // Informational; release() goes by address
+        resetHeader(msg);
+        MESSAGE_POOL_PROBE2(borrow__return, poolId_, index);
+        record(PoolEvent::Borrow, index);
+        return msg;
+    }
+
+    // Highest class with a waiter that could take a free slot now.
+    CondVar* nextToWake() {
+        for (size_t i = kPriorities; i-- > 0;) {
+            if (priorities_[i].waiting > 0 && canTake(static_cast<Priority>(i))) {
+                return &priorities_[i].cv;
+            }
+        }
+        return nullptr;
+    }
+
+    // Passes a wakeup on after a waiter got its slot, in case the release
+    // that woke it freed more than one or notified a class twice.
+    void wakeNext() {
+        if (CondVar* cv = nextToWake()) cv->notify_one();
+    }
+
+    // Wakes every blocked borrower to recheck its stop token.
+    void wakeAll() {
+        std::lock_guard<Mutex> lock(mutex_);
+        for (PriorityClass& cls : priorities_) {
+            cls.cv.notify_all();
+            for (Waiter* waiter = cls.head; waiter; waiter = waiter->next) {
+                if (!waiter->resume) waiter->cv.notify_one();
+            }
+        }
+    }
+
+    bool interrupted(const StopToken* token) const { return shutdown_ || (token && token->stopRequested()); }
+
+    // Blocks until a slot is free for this priority, recording the wait.
+    // Returns the slot handed over in fair mode, otherwise kNoSlot with the
+    // free list ready to take from. Throws on timeout, shutdown or a stop
+    // requested on token.
+    size_t waitForFree(std::unique_lock<Mutex>& lock, Priority priority, const StopToken* token) {
+        PriorityClass& cls = priorities_[static_cast<size_t>(priority)];
+        MESSAGE_POOL_PROBE1(wait__begin, poolId_);
+        record(PoolEvent::Wait, 0);
+        cls.waits.fetch_add(1, std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        size_t slot = kNoSlot;
+        bool ready;
+        if (fair_) {
+            Waiter waiter;
+            waiter.priority = static_cast<size_t>(priority);
+            enqueue(&waiter);
+            reclaimAllRemote(); // After counting ourselves blocked; may hand us a slot
+            waiter.cv.wait_for(lock, timeout_, [&]() {
+                return waiter.slot != kNoSlot || waiter.cancelled || interrupted(token);
+            });
+            // A slot handed over wins over a stop that raced with it
+            ready = waiter.slot != kNoSlot;
+            if (!ready && !waiter.cancelled) unlink(&waiter);
+            slot = waiter.slot;
+        } else {
+            ++cls.waiting;
+            blocked_.fetch_add(1, std::memory_order_seq_cst);
+            reclaimAllRemote();
+            cls.cv.wait_for(lock, timeout_, [&]() { return canTake(priority) || interrupted(token); });
+            blocked_.fetch_sub(1, std::memory_order_relaxed);
+            --cls.waiting;
+            ready = canTake(priority) && !shutdown_;
+        }
+        auto waited = std::chrono::steady_clock::now() - start;
+        uint64_t waitedNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count());
+        MESSAGE_POOL_PROBE2(wait__end, poolId_, waitedNs);
+
+        stats_.onWait(waitedNs);
+        waitTime_.record(waitedNs);
+        if (!ready && shutdown_) {
+            throw std::runtime_error("Message pool is shut down");
+        }
+        if (!ready && token && token->stopRequested()) {
+            throw std::runtime_error("Borrow cancelled");
+        }
+        if (!ready) {
+            MESSAGE_POOL_PROBE2(timeout, poolId_, waitedNs);
+            record(PoolEvent::Timeout, 0);
+            stats_.onTimeout();
+            cls.timeouts.fetch_add(1, std::memory_order_relaxed);
+            throw std::runtime_error("Timeout waiting for available message");
+        }
+        return slot;
+    }
+
+    // Called under the lock whenever the free count changes.
+    void freeCountChanged() {
+        checkWatermarks();
+        if (availableFd_ >= 0) updateAvailableFd();
+        updateLean();
+    }
+
+    // Tracks whether the pool is short of free slots, when remote releases
+    // must not park slots where only their owner's next borrow would find
+    // them. Becoming lean sweeps whatever was parked before the flag showed.
+    void updateLean() {
+        bool lean = freeList_.empty() || underPressure_.load(std::memory_order_relaxed);
+        if (lean == lean_.load(std::memory_order_relaxed)) return;
+        lean_.store(lean, std::memory_order_seq_cst);
+        if (lean) reclaimAllRemote(); // Re-enters via freeSlot(); lean_ is already set
+    }
+
+    // Keeps availableFd() readable exactly while a Normal borrower could take
+    // a slot, parked ones included: a write when the pool recovers from
+    // exhaustion, a drain when it runs out.
+    void updateAvailableFd() {
+        size_t reserved = reservedFor(Priority::Normal);
+        size_t free = freeList_.size();
+        if (free <= reserved) free += parkedSlots();
+        bool available = free > reserved;
+        if (available == availableSignalled_) return;
+        availableSignalled_ = available;
+        uint64_t value = 1;
+        if (available) {
+            (void)!::write(availableFd_, &value, sizeof(value));
+        } else {
+            (void)!::read(availableFd_, &value, sizeof(value));
+        }
+    }
+
+    // Parked slots count as free, like in available(); they are only summed
+    // when the free list alone would cross a watermark.
+    void checkWatermarks() {
+        if (!watermarksSet_) return;
+        size_t free = freeList_.size();
+        bool pressure = underPressure_.load(std::memory_order_relaxed);
+        if (pressure ? free < highWatermark_ : free <= lowWatermark_) free += parkedSlots();
+        if (!pressure && free <= lowWatermark_) {
+            signalWatermark(Watermark::Low, free);
+        } else if (pressure && free >= highWatermark_) {
+            signalWatermark(Watermark::High, free);
+        }
+    }
+
+    void signalWatermark(Watermark mark, size_t free) {
+        underPressure_.store(mark == Watermark::Low, std::memory_order_relaxed);
+        uint64_t one = 1;
+        (void)!::write(watermarkFd_, &one, sizeof(one));
+        if (watermarkCallback_) watermarkCallback_(mark, free);
+    }
+
+    // Borrow-time bookkeeping for one slot: a couple of stores per borrow.
+    struct SlotInfo {
+        uint64_t borrowTicks = 0; // CycleClock time of the borrow
+        uint64_t owner = 0;       // Borrowing thread
+        CallSite site;
+        uint16_t remoteList = kNoRemoteList; // Owner's remote-free list
+    };
+
+    static uint64_t currentThreadId() {
+        thread_local uint64_t tid = static_cast<uint64_t>(::syscall(SYS_gettid));
+        return tid;
+    }
+
+    void record(PoolEvent op, size_t slot) {
+        if (EventRecorder* recorder = recorder_.load(std::memory_order_acquire)) {
+            recorder->record(op, slot);
+        }
+    }
+
+    // Zeroes the whole payload, live bytes or not. On x86 every line of the
+    // slot is written with streaming stores, which bypass the cache: the
+    // first line is rebuilt with the header in place, and in release builds
+    // the last one only shares the slot's padding. Checked builds write the
+    // tail before the guard zone normally instead. Callers follow a run of
+    // scrubs with one scrubFence() before the slots are published again.
+    static void scrubPayload(NetworkMessage* msg) {
+#if defined(__x86_64__)
+        static_assert(offsetof(NetworkMessage, data) < 64, "header must fit in the first line");
+        char* slot = reinterpret_cast<char*>(msg);
+        alignas(16) char first[64] = {};
+        std::memcpy(first, slot, offsetof(NetworkMessage, data));
+        for (size_t i = 0; i < 64; i += 16) {
+            _mm_stream_si128(reinterpret_cast<__m128i*>(slot + i),
+                             _mm_load_si128(reinterpret_cast<const __m128i*>(first + i)));
+        }
+
+        const __m128i zero = _mm_setzero_si128();
+        constexpr size_t kTail = sizeof(NetworkMessage) / 64 * 64;
+#if MESSAGE_POOL_CHECKED
+        constexpr size_t kStreamed = kTail;
+#else
+        constexpr size_t kStreamed = kSlotStride;
+#endif
+        for (size_t i = 64; i < kStreamed; i += 16) {
+            _mm_stream_si128(reinterpret_cast<__m128i*>(slot + i), zero);
+        }
+        if (kStreamed < sizeof(NetworkMessage)) {
+            std::memset(slot + kTail, 0, sizeof(NetworkMessage) - kTail);
+        }
+#else
+        std::memset(msg->data, 0, sizeof(msg->data));
+#endif
+    }
+
+    // Orders earlier streaming stores before the slots are handed on.
+    static void scrubFence() {
+#if defined(__x86_64__)
+        _mm_sfence();
+#endif
+    }
+
+    // OnBorrow scrubbing, once the pool lock is dropped: the slots are
+    // already the caller's.
+    void scrubBorrowed(NetworkMessage* const* msgs, size_t count) {
+        if (scrub_.load(std::memory_order_relaxed) != Scrub::OnBorrow || count == 0) return;
+        for (size_t i = 0; i < count; ++i) {
+            scrubPayload(msgs[i]);
+        }
+        scrubFence();
+    }
+
+    // Background-scrub release: queue the slot for the scrubber, which frees
+    // it. Takes only the scrub queue's lock.
+    void releaseToScrubber(size_t index) {
+        uint64_t heldTicks = CycleClock::now() - slotInfo_[index].borrowTicks;
+        record(PoolEvent::Release, index);
+        scrubPending_.fetch_add(1, std::memory_order_relaxed);
+        bool idle;
+        {
+            std::lock_guard<std::mutex> lock(scrubMutex_);
+            idle = dirty_.empty(); // Otherwise the scrubber is already due to wake
+            dirty_.push_back(index);
+        }
+        if (idle) scrubReady_.notify_one();
+        MESSAGE_POOL_PROBE2(release, poolId_, index);
+        stats_.onRelease();
+        holdTime_.record(CycleClock::toNanos(heldTicks));
+    }
+
+    void scrubLoop() {
+        std::vector<size_t> batch;
+        batch.reserve(poolSize_);
+        std::unique_lock<std::mutex> lock(scrubMutex_);
+        while (true) {
+            scrubReady_.wait(lock, [this]() { return !dirty_.empty() || scrubStop_; });
+            if (dirty_.empty()) return; // Stopping with nothing left to free
+            batch.swap(dirty_);
+            lock.unlock();
+
+            for (size_t index : batch) {
+                scrubPayload(slotAt(index));
+            }
+            scrubFence();
+            CondVar* wake = nullptr;
+            {
+                std::lock_guard<Mutex> poolLock(mutex_);
+                for (size_t index : batch) {
+                    if (CondVar* cv = freeSlot(index)) wake = cv;
+                }
+                scrubPending_.fetch_sub(batch.size(), std::memory_order_relaxed);
+            }
+            if (wake) wake->notify_all();
+            batch.clear();
+            lock.lock();
+        }
+    }
+
+    void stopScrubber() {
+        if (!scrubber_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(scrubMutex_);
+            scrubStop_ = true;
+        }
+        scrubReady_.notify_one();
+        scrubber_.join();
+    }
+
+    // Warms the slot the next borrow will take, under the lock.
+    void prefetchNext() {
+        if (prefetch_ == Prefetch::Off || freeList_.empty()) return;
+        prefetchForWrite(slotAt(reuse_ == ReuseOrder::Lifo ? freeList_.back() : freeList_.front()));
+    }
+
+    static void prefetchForWrite(const NetworkMessage* msg) {
+        const char* bytes = reinterpret_cast<const char*>(msg);
+        for (size_t offset = 0; offset < sizeof(NetworkMessage); offset += 64) {
+            __builtin_prefetch(bytes + offset, 1, 3);
+        }
+    }
+
+    static void resetHeader(NetworkMessage* msg) {
+        msg->length = 0;
+        msg->type = 0;
+        msg->sequence = 0;
+        msg->timestamp = 0;
+    }
+
+    // Checks a message on its way back, marks its slot kReleasing and
+    // returns the index. The index comes from the address, not the id field,
+    // so a foreign or corrupted message can't pass for one of ours. Only one
+    // of several racing releases of a slot wins the mark; the rest throw,
+    // whichever path (locked, remote, scrubber) the winner then takes.
+    size_t validate(const NetworkMessage* msg) {
+        uintptr_t offset = reinterpret_cast<uintptr_t>(msg) - reinterpret_cast<uintptr_t>(slots_);
+        if (offset >= poolSize_ * kSlotStride || offset % kSlotStride != 0) {
+            throw std::runtime_error("Message does not belong to this pool");
+        }
+        size_t index = offset / kSlotStride;
+        if (msg->length > sizeof(msg->data)) {
+            throw std::runtime_error("Invalid message length");
+        }
+        checkGuard(index);
+        if (kConfined) { // Nothing can race the check
+            if (stateOf(index) != kBorrowed) throw std::runtime_error("Message is not borrowed");
+            setState(index, kReleasing);
+            return index;
+        }
+        uint8_t expected = kBorrowed;
+        if (!__atomic_compare_exchange_n(&states_[index], &expected, kReleasing, false, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_RELAXED)) {
+            throw std::runtime_error("Message is not borrowed");
+        }
+        return index;
+    }
+
+    // Undoes validate() for a batch that is rejected as a whole.
+    void unmarkReleasing(size_t index) { setState(index, kBorrowed); }
+
+    // Slot states are written under the lock but marked by validate()
+    // without it, so every access goes through these.
+    uint8_t stateOf(size_t index) const { return __atomic_load_n(&states_[index], __ATOMIC_ACQUIRE); }
+    void setState(size_t index, uint8_t state) { __atomic_store_n(&states_[index], state, __ATOMIC_RELEASE); }
+
+    // Index of a message that already passed validate().
+    size_t slotIndex(const NetworkMessage* msg) const {
+        return static_cast<size_t>(reinterpret_cast<const char*>(msg) - reinterpret_cast<const char*>(slots_)) /
+               kSlotStride;
+    }
+
+    // Checked-build helpers; each compiles to nothing otherwise.
+
+    unsigned char* guardOf(size_t index) const {
+        return reinterpret_cast<unsigned char*>(slotAt(index)) + sizeof(NetworkMessage);
+    }
+
+    void armGuard(size_t index) {
+#if MESSAGE_POOL_CHECKED
+        std::memset(guardOf(index), kCanary, kGuardSize);
+#ifdef MESSAGE_POOL_ASAN
+        ASAN_POISON_MEMORY_REGION(guardOf(index), kGuardSize);
+#endif
+#else
+        (void)index;
+#endif
+    }
+
+    // ASan already reported any write into the guard zone.
+    void checkGuard(size_t index) const {
+#if MESSAGE_POOL_CHECKED && !defined(MESSAGE_POOL_ASAN)
+        const unsigned char* guard = guardOf(index);
+        for (size_t i = 0; i < kGuardSize; ++i) {
+            if (guard[i] != kCanary) throw std::runtime_error("Message overran its slot");
+        }
+#else
+        (void)index;
+#endif
+    }
+
+    void poisonPayload(size_t index) {
+#if MESSAGE_POOL_CHECKED
+        char* data = slotAt(index)->data;
+#ifdef MESSAGE_POOL_ASAN
+        ASAN_UNPOISON_MEMORY_REGION(data, sizeof(NetworkMessage::data)); // Released twice
+#endif
+        std::memset(data, kPoison, sizeof(NetworkMessage::data));
+#ifdef MESSAGE_POOL_ASAN
+        ASAN_POISON_MEMORY_REGION(data, sizeof(NetworkMessage::data));
+#endif
+#else
+        (void)index;
+#endif
+    }
+
+    // A poisoned payload that changed was written after its release. The
+    // slot is left out of circulation. Scrubbing modes still hand out zeroes.
+    void checkPoison(size_t index) {
+#if MESSAGE_POOL_CHECKED
+        char* data = slotAt(index)->data;
+#ifdef MESSAGE_POOL_ASAN
+        ASAN_UNPOISON_MEMORY_REGION(data, sizeof(NetworkMessage::data));
+#endif
+        for (size_t i = 0; i < sizeof(NetworkMessage::data); ++i) {
+            if (static_cast<unsigned char>(data[i]) != kPoison) {
+                throw std::runtime_error("Message written after release");
+            }
+        }
+        if (scrub_.load(std::memory_order_relaxed) != Scrub::Off) {
+            std::memset(data, 0, sizeof(NetworkMessage::data));
+        }
+#else
+        (void)index;
+#endif
+    }
+
+    static size_t alignUp(size_t n, size_t align) { return (n + align - 1) / align * align; }
+
+    size_t statesOffset() const { return alignUp(sizeof(PoolFileHeader), 64); }
+    size_t slotsOffset() const { return alignUp(statesOffset() + poolSize_, 64); }
+    size_t regionSize() const { return slotsOffset() + poolSize_ * kSlotStride; }
+
+    // Maps the pool region; fd < 0 selects anonymous memory. Pages are
+    // pre-faulted so the first borrows after start-up don't take page faults.
+    void mapRegion(int fd) {
+        int flags = MAP_SHARED | MAP_POPULATE;
+        if (fd < 0) flags |= MAP_ANONYMOUS;
+        void* addr = ::mmap(nullptr, regionSize(), PROT_READ | PROT_WRITE, flags, fd, 0);
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error("Failed to map message pool storage");
+        }
+        region_ = static_cast<char*>(addr);
+        header_ = reinterpret_cast<PoolFileHeader*>(region_);
+        states_ = reinterpret_cast<uint8_t*>(region_ + statesOffset());
+        slots_ = reinterpret_cast<NetworkMessage*>(region_ + slotsOffset());
+    }
+
+    void initialize() {
+        freeList_.reserve(poolSize_);
+        for (size_t i = 0; i < poolSize_; ++i) {
+            slotAt(i)->id = static_cast<int>(i);
+            setState(i, kFree);
+            armGuard(i);
+            poisonPayload(i);
+            freeList_.push_back(i);
+        }
+        header_->version = PoolFileHeader::kVersion;
+        header_->slotSize = static_cast<uint32_t>(kSlotStride);
+        header_->capacity = poolSize_;
+        header_->magic = PoolFileHeader::kMagic; // Written last: marks the region valid
+    }
+
+    void attach() {
+        if (header_->magic != PoolFileHeader::kMagic ||
+            header_->version != PoolFileHeader::kVersion ||
+            header_->slotSize != kSlotStride ||
+            header_->capacity != poolSize_) {
+            ::munmap(region_, regionSize());
+            throw std::runtime_error("Backing file does not match pool layout");
+        }
+
+        freeList_.reserve(poolSize_);
+        for (size_t i = 0; i < poolSize_; ++i) {
+            slotAt(i)->id = static_cast<int>(i);
+            armGuard(i);
+            uint8_t state = stateOf(i);
+            if (state != kBorrowed) { // A release cut short counts as done
+                if (state == kReleasing) {
+                    // Maybe still queued for a scrubber that died with its
+                    // process: don't hand the last borrower's data on
+                    std::memset(slotAt(i)->data, 0, sizeof(NetworkMessage::data));
+                    setState(i, kFree);
+                }
+                poisonPayload(i);
+                freeList_.push_back(i);
+            } else {
+                slotInfo_[i] = {CycleClock::now(), 0, CallSite{}};
+                recovered_.push_back(slotAt(i));
+            }
+        }
+        stats_.onFreeCount(freeList_.size());
+    }
+
+    uint32_t poolId_ = nextMessagePoolId();
     size_t poolSize_;
-    std::vector<std::unique_ptr<NetworkMessage>> storage_;
-    std::vector<size_t> freeList_;
-    mutable std::mutex mutex_;
-    std::condition_variable cv_;
+    char* region_ = nullptr;
+    int lockFd_ = -1; // Backing file, held open for its lock
+    PoolFileHeader* header_ = nullptr;
+    uint8_t* states_ = nullptr;
+    NetworkMessage* slots_ = nullptr;
+    SlotRing freeList_;
+    std::vector<NetworkMessage*> recovered_;
+    mutable Mutex mutex_;
+    PriorityClass priorities_[kPriorities];
+    size_t reserved_ = 0; // Free slots only High may take
+    bool fair_ = false;
+    bool shutdown_ = false;
+    ReuseOrder reuse_ = ReuseOrder::Fifo;
+    Prefetch prefetch_ = Prefetch::Off;
+
+    // Payload scrubbing; dirty_ is the background scrubber's queue
+    std::atomic<Scrub> scrub_{Scrub::Off};
+    std::mutex scrubMutex_;
+    std::condition_variable scrubReady_;
+    std::vector<size_t> dirty_;
+    bool scrubStop_ = false; // Guarded by scrubMutex_
+    std::atomic<size_t> scrubPending_{0};
+    std::thread scrubber_;
+
+    // Remote-free lists; blocked_ counts borrowers that are waiting or queued
+    std::atomic<bool> remoteFree_{false};
+    RemoteList remote_[kMaxRemoteOwners];
+    size_t remoteOwners_ = 0; // Guarded by mutex_
+    std::atomic<size_t> blocked_{0};
+    std::atomic<bool> lean_{false}; // See updateLean()
+    size_t queued_ = 0;   // Fair-mode waiters across all classes
     std::chrono::milliseconds timeout_;
+    BasicPoolStats<LockPolicy::template Counter, kConfined ? 1 : 16> stats_;
+    BasicLatencyHistogram<LockPolicy::template Counter> waitTime_;
+    BasicLatencyHistogram<LockPolicy::template Counter> holdTime_;
+    std::vector<SlotInfo> slotInfo_;
+    std::unique_ptr<uint32_t[]> remoteNext_; // Remote-free list links, one per slot
+    std::atomic<EventRecorder*> recorder_{nullptr};
+
+    // Watermarks, guarded by mutex_
+    bool watermarksSet_ = false;
+    size_t lowWatermark_ = 0;
+    size_t highWatermark_ = 0;
+    WatermarkCallback watermarkCallback_;
+    int watermarkFd_ = -1;
+    std::atomic<bool> underPressure_{false};
+
+    int availableFd_ = -1;            // Guarded by mutex_
+    bool availableSignalled_ = false; // Whether availableFd_ currently reads as ready
 };
+
+using MessagePool = BasicMessagePool<MutexLock>;
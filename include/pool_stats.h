@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+struct PoolStatsSnapshot {
+    uint64_t borrows = 0;        // Messages handed out (batch borrows count each message)
+    uint64_t releases = 0;       // Messages returned
+    uint64_t timeouts = 0;       // Borrows that gave up waiting
+    uint64_t waits = 0;          // Borrows that found the pool empty and blocked
+    uint64_t waitTimeNs = 0;     // Total time spent blocked
+    size_t lowWaterFree = 0;     // Fewest free slots ever observed
+    size_t highWaterInUse = 0;   // Most slots borrowed at once
+};
+
+// Pool counters kept in cache-line-sized stripes. Each thread updates its own
+// stripe with relaxed atomics, so threads don't bounce a shared line, and
+// readers sum the stripes without touching the pool mutex. The watermarks
+// are written by the pool while it holds its lock and only read here.
+// Counter is the lock policy's counter type; a single stripe skips the
+// per-thread stripe lookup.
+template <template <class> class Counter, size_t kStripes>
+class BasicPoolStats {
+public:
+    explicit BasicPoolStats(size_t capacity)
+        : capacity_(capacity), lowWaterFree_(capacity), highWaterInUse_(0) {}
+
+    void onBorrow(uint64_t count = 1) { add(stripe().borrows, count); }
+    void onRelease(uint64_t count = 1) { add(stripe().releases, count); }
+    void onTimeout() { add(stripe().timeouts, 1); }
+
+    void onWait(uint64_t waitTimeNs) {
+        Stripe& s = stripe();
+        add(s.waits, 1);
+        add(s.waitTimeNs, waitTimeNs);
+    }
+
+    // Called with the pool lock held whenever the free count drops.
+    void onFreeCount(size_t freeCount) {
+        if (freeCount < lowWaterFree_.load(std::memory_order_relaxed)) {
+            lowWaterFree_.store(freeCount, std::memory_order_relaxed);
+        }
+        size_t inUse = capacity_ - freeCount;
+        if (inUse > highWaterInUse_.load(std::memory_order_relaxed)) {
+            highWaterInUse_.store(inUse, std::memory_order_relaxed);
+        }
+    }
+
+    PoolStatsSnapshot snapshot() const {
+        PoolStatsSnapshot snap;
+        for (const Stripe& s : stripes_) {
+            snap.borrows += s.borrows.load(std::memory_order_relaxed);
+            snap.releases += s.releases.load(std::memory_order_relaxed);
+            snap.timeouts += s.timeouts.load(std::memory_order_relaxed);
+            snap.waits += s.waits.load(std::memory_order_relaxed);
+            snap.waitTimeNs += s.waitTimeNs.load(std::memory_order_relaxed);
+        }
+        snap.lowWaterFree = lowWaterFree_.load(std::memory_order_relaxed);
+        snap.highWaterInUse = highWaterInUse_.load(std::memory_order_relaxed);
+        return snap;
+    }
+
+private:
+    struct alignas(64) Stripe {
+        Counter<uint64_t> borrows{0};
+        Counter<uint64_t> releases{0};
+        Counter<uint64_t> timeouts{0};
+        Counter<uint64_t> waits{0};
+        Counter<uint64_t> waitTimeNs{0};
+    };
+
+    static void add(Counter<uint64_t>& counter, uint64_t n) {
+        counter.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // Threads are assigned stripes round-robin on first use.
+    Stripe& stripe() {
+        if (kStripes == 1) return stripes_[0];
+        static std::atomic<size_t> nextStripe{0};
+        thread_local size_t index = nextStripe.fetch_add(1, std::memory_order_relaxed) % kStripes;
+        return stripes_[index];
+    }
+
+    size_t capacity_;
+    Stripe stripes_[kStripes];
+    Counter<size_t> lowWaterFree_;
+    Counter<size_t> highWaterInUse_;
+};
+
+using PoolStats = BasicPoolStats<std::atomic, 16>;
@@ -0,0 +1,27 @@
+#pragma once
+
+// Static tracepoints for perf/bpftrace. With <sys/sdt.h> (systemtap-sdt-dev)
+// these are USDT probes in the "message_pool" provider: a single nop each
+// until a tracer attaches. Without it, or with MESSAGE_POOL_NO_USDT, they
+// compile to nothing. Probes and their arguments:
+//
+//   borrow__entry(pool)         borrow__return(pool, slot)
+//   wait__begin(pool)           wait__end(pool, wait_ns)
+//   timeout(pool, wait_ns)      release(pool, slot)
+//
+// e.g. bpftrace -e 'usdt:./app:message_pool:wait__end { @[arg0] = hist(arg1); }'
+
+#if !defined(MESSAGE_POOL_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define MESSAGE_POOL_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef MESSAGE_POOL_HAVE_USDT
+#define MESSAGE_POOL_PROBE1(name, a) DTRACE_PROBE1(message_pool, name, a)
+#define MESSAGE_POOL_PROBE2(name, a, b) DTRACE_PROBE2(message_pool, name, a, b)
+#else
+#define MESSAGE_POOL_PROBE1(name, a) do { (void)sizeof(a); } while (0)
+#define MESSAGE_POOL_PROBE2(name, a, b) do { (void)sizeof(a); (void)sizeof(b); } while (0)
+#endif
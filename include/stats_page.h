@@ -0,0 +1,255 @@
+#pragma once
+
+#include "message_pool.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// One pool's counters and histograms as published to shared memory.
+struct StatsSample {
+    uint64_t capacity = 0;
+    uint64_t available = 0;
+    uint64_t publishedNs = 0; // CLOCK_REALTIME when the sample was taken
+    PoolStatsSnapshot stats;
+    HistogramSnapshot waitTime;
+    HistogramSnapshot holdTime;
+};
+
+// Layout of the shared page. Every field is an address-free atomic so the
+// page can be read from another process; sequence is a seqlock counter that
+// is odd while the publisher is writing.
+struct StatsPage {
+    static constexpr uint64_t kMagic = 0x5441545350474d00ULL; // "\0MGPSTAT"
+    static constexpr uint32_t kVersion = 1;
+
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> capacity;
+    std::atomic<uint64_t> available;
+    std::atomic<uint64_t> publishedNs;
+    std::atomic<uint64_t> borrows;
+    std::atomic<uint64_t> releases;
+    std::atomic<uint64_t> timeouts;
+    std::atomic<uint64_t> waits;
+    std::atomic<uint64_t> waitTimeNs;
+    std::atomic<uint64_t> lowWaterFree;
+    std::atomic<uint64_t> highWaterInUse;
+    std::atomic<uint64_t> waitBuckets[HistogramSnapshot::kBuckets];
+    std::atomic<uint64_t> holdBuckets[HistogramSnapshot::kBuckets];
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared stats need lock-free atomics");
+
+    static std::string shmName(const std::string& name) { return "/message_pool." + name; }
+};
+
+// Publishes a pool's stats into a named shared-memory page, from a background
+// thread every interval and on demand via publish(). The page is locked while
+// its publisher lives: a second publisher under the same name throws, while
+// a page left behind by a publisher that died is taken over. The page is
+// removed when the publisher is destroyed.
+class StatsPublisher {
+public:
+    StatsPublisher(const MessagePool& pool, const std::string& name,
+                   std::chrono::milliseconds interval = std::chrono::milliseconds(100))
+        : pool_(pool), shmName_(StatsPage::shmName(name)), interval_(interval) {
+        int fd = ::shm_open(shmName_.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to create stats page: " + shmName_);
+        }
+        if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Stats page is in use by another publisher: " + shmName_);
+        }
+        if (::ftruncate(fd, sizeof(StatsPage)) != 0) {
+            ::close(fd);
+            ::shm_unlink(shmName_.c_str());
+            throw std::runtime_error("Failed to size stats page: " + shmName_);
+        }
+        void* addr = ::mmap(nullptr, sizeof(StatsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            ::shm_unlink(shmName_.c_str());
+            throw std::runtime_error("Failed to map stats page: " + shmName_);
+        }
+        lockFd_ = fd;
+
+        page_ = static_cast<StatsPage*>(addr);
+        page_->version = StatsPage::kVersion;
+        // A dead publisher may have left the sequence odd, mid-write
+        uint64_t seq = page_->sequence.load(std::memory_order_relaxed);
+        page_->sequence.store((seq + 1) & ~uint64_t(1), std::memory_order_relaxed);
+        publish();
+        std::atomic_thread_fence(std::memory_order_release);
+        page_->magic = StatsPage::kMagic;
+
+        if (interval_.count() > 0) {
+            thread_ = std::thread([this]() { run(); });
+        }
+    }
+
+    StatsPublisher(const StatsPublisher&) = delete;
+    StatsPublisher& operator=(const StatsPublisher&) = delete;
+
+    ~StatsPublisher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        if (thread_.joinable()) thread_.join();
+
+        ::munmap(page_, sizeof(StatsPage));
+        ::shm_unlink(shmName_.c_str());
+        ::close(lockFd_);
+    }
+
+    void publish() {
+        PoolStatsSnapshot stats = pool_.stats();
+        HistogramSnapshot waitTime = pool_.waitHistogram();
+        HistogramSnapshot holdTime = pool_.holdHistogram();
+        uint64_t available = pool_.available();
+
+        std::lock_guard<std::mutex> lock(publishMutex_);
+        uint64_t seq = page_->sequence.load(std::memory_order_relaxed);
+        page_->sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        set(page_->capacity, pool_.capacity());
+        set(page_->available, available);
+        set(page_->publishedNs, realtimeNanos());
+        set(page_->borrows, stats.borrows);
+        set(page_->releases, stats.releases);
+        set(page_->timeouts, stats.timeouts);
+        set(page_->waits, stats.waits);
+        set(page_->waitTimeNs, stats.waitTimeNs);
+        set(page_->lowWaterFree, stats.lowWaterFree);
+        set(page_->highWaterInUse, stats.highWaterInUse);
+        for (size_t i = 0; i < HistogramSnapshot::kBuckets; ++i) {
+            set(page_->waitBuckets[i], waitTime.buckets[i]);
+            set(page_->holdBuckets[i], holdTime.buckets[i]);
+        }
+
+        page_->sequence.store(seq + 2, std::memory_order_release);
+    }
+
+private:
+    static void set(std::atomic<uint64_t>& field, uint64_t value) {
+        field.store(value, std::memory_order_relaxed);
+    }
+
+    static uint64_t realtimeNanos() {
+        timespec now;
+        ::clock_gettime(CLOCK_REALTIME, &now);
+        return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + static_cast<uint64_t>(now.tv_nsec);
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!cv_.wait_for(lock, interval_, [this]() { return stop_; })) {
+            lock.unlock();
+            publish();
+            lock.lock();
+        }
+    }
+
+    const MessagePool& pool_;
+    std::string shmName_;
+    std::chrono::milliseconds interval_;
+    StatsPage* page_ = nullptr;
+    int lockFd_ = -1; // The page, held open for its lock
+    std::mutex publishMutex_; // Serializes publish() between the thread and callers
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+// Read-only view of a page published by StatsPublisher, possibly in another process.
+class StatsPageReader {
+public:
+    explicit StatsPageReader(const std::string& name) : shmName_(StatsPage::shmName(name)) {
+        int fd = ::shm_open(shmName_.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            throw std::runtime_error("No stats page named " + shmName_);
+        }
+        void* addr = ::mmap(nullptr, sizeof(StatsPage), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error("Failed to map stats page: " + shmName_);
+        }
+
+        page_ = static_cast<const StatsPage*>(addr);
+        if (page_->magic != StatsPage::kMagic || page_->version != StatsPage::kVersion) {
+            ::munmap(const_cast<StatsPage*>(page_), sizeof(StatsPage));
+            throw std::runtime_error("Stats page has an unknown layout: " + shmName_);
+        }
+    }
+
+    StatsPageReader(const StatsPageReader&) = delete;
+    StatsPageReader& operator=(const StatsPageReader&) = delete;
+
+    ~StatsPageReader() {
+        ::munmap(const_cast<StatsPage*>(page_), sizeof(StatsPage));
+    }
+
+    // Copies a consistent sample, retrying while the publisher is mid-write.
+    // A write that doesn't finish within kStaleAfter means the publisher died
+    // in the middle of it: the page is reported stale by throwing.
+    StatsSample read() const {
+        static constexpr std::chrono::milliseconds kStaleAfter{100};
+        StatsSample sample;
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        for (;;) {
+            uint64_t before = page_->sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                auto now = std::chrono::steady_clock::now();
+                if (deadline == std::chrono::steady_clock::time_point::max()) {
+                    deadline = now + kStaleAfter;
+                } else if (now > deadline) {
+                    throw std::runtime_error("Stats page is stale, its publisher stopped mid-update: " + shmName_);
+                }
+                std::this_thread::yield();
+                continue;
+            }
+
+            sample.capacity = get(page_->capacity);
+            sample.available = get(page_->available);
+            sample.publishedNs = get(page_->publishedNs);
+            sample.stats.borrows = get(page_->borrows);
+            sample.stats.releases = get(page_->releases);
+            sample.stats.timeouts = get(page_->timeouts);
+            sample.stats.waits = get(page_->waits);
+            sample.stats.waitTimeNs = get(page_->waitTimeNs);
+            sample.stats.lowWaterFree = get(page_->lowWaterFree);
+            sample.stats.highWaterInUse = get(page_->highWaterInUse);
+            for (size_t i = 0; i < HistogramSnapshot::kBuckets; ++i) {
+                sample.waitTime.buckets[i] = get(page_->waitBuckets[i]);
+                sample.holdTime.buckets[i] = get(page_->holdBuckets[i]);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (page_->sequence.load(std::memory_order_relaxed) == before) {
+                return sample;
+            }
+        }
+    }
+
+private:
+    static uint64_t get(const std::atomic<uint64_t>& field) {
+        return field.load(std::memory_order_relaxed);
+    }
+
+    std::string shmName_;
+    const StatsPage* page_ = nullptr;
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// C++17 stand-in for std::stop_source/stop_token/stop_callback, enough to
+// interrupt a blocked borrow(). A StopSource asks for a stop once; tokens
+// observe it; a StopCallback runs its function when the stop is requested,
+// or immediately if it already was.
+class StopCallback;
+
+namespace detail {
+
+struct StopState {
+    std::atomic<bool> stopped{false};
+    std::mutex mutex;
+    std::condition_variable done;
+    std::vector<StopCallback*> callbacks; // Registered, not yet run
+    StopCallback* running = nullptr;
+    std::thread::id runningThread;
+};
+
+} // namespace detail
+
+class StopToken {
+public:
+    StopToken() = default;
+
+    bool stopRequested() const { return state_ && state_->stopped.load(std::memory_order_acquire); }
+    bool stopPossible() const { return state_ != nullptr; }
+
+private:
+    friend class StopSource;
+    friend class StopCallback;
+
+    explicit StopToken(std::shared_ptr<detail::StopState> state) : state_(std::move(state)) {}
+
+    std::shared_ptr<detail::StopState> state_;
+};
+
+class StopCallback {
+public:
+    StopCallback(const StopToken& token, std::function<void()> fn) : state_(token.state_), fn_(std::move(fn)) {
+        if (!state_) return;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            if (!state_->stopped.load(std::memory_order_acquire)) {
+                state_->callbacks.push_back(this);
+                return;
+            }
+        }
+        fn_();
+    }
+
+    StopCallback(const StopCallback&) = delete;
+    StopCallback& operator=(const StopCallback&) = delete;
+
+    // Waits for the callback if another thread is running it right now.
+    ~StopCallback() {
+        if (!state_) return;
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        auto& callbacks = state_->callbacks;
+        for (size_t i = 0; i < callbacks.size(); ++i) {
+            if (callbacks[i] == this) {
+                callbacks.erase(callbacks.begin() + static_cast<std::ptrdiff_t>(i));
+                return;
+            }
+        }
+        if (state_->runningThread != std::this_thread::get_id()) {
+            state_->done.wait(lock, [this]() { return state_->running != this; });
+        }
+    }
+
+private:
+    friend class StopSource;
+
+    std::shared_ptr<detail::StopState> state_;
+    std::function<void()> fn_;
+};
+
+class StopSource {
+public:
+    StopSource() : state_(std::make_shared<detail::StopState>()) {}
+
+    StopToken token() const { return StopToken(state_); }
+
+    bool stopRequested() const { return state_->stopped.load(std::memory_order_acquire); }
+
+    // Runs the registered callbacks on this thread. Returns false if a stop
+    // had already been requested.
+    bool requestStop() {
+        if (state_->stopped.exchange(true, std::memory_order_acq_rel)) return false;
+
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        state_->runningThread = std::this_thread::get_id();
+        while (!state_->callbacks.empty()) {
+            StopCallback* callback = state_->callbacks.back();
+            state_->callbacks.pop_back();
+            state_->running = callback;
+            lock.unlock();
+            callback->fn_();
+            lock.lock();
+            state_->running = nullptr;
+            state_->done.notify_all();
+        }
+        state_->runningThread = std::thread::id();
+        return true;
+    }
+
+private:
+    std::shared_ptr<detail::StopState> state_;
+};
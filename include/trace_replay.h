@@ -0,0 +1,187 @@
+#pragma once
+
+#include "event_recorder.h"
+#include "latency_histogram.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// A trace file loaded into memory, events sorted by time.
+struct Trace {
+    uint64_t capacity = 0;
+    std::vector<TraceEvent> events;
+
+    static Trace load(const std::string& path) {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            throw std::runtime_error("Failed to open trace file: " + path);
+        }
+
+        TraceFileHeader header;
+        if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+            header.magic != TraceFileHeader::kMagic ||
+            header.version != TraceFileHeader::kVersion ||
+            header.eventSize != sizeof(TraceEvent)) {
+            std::fclose(file);
+            throw std::runtime_error("Not a message pool trace: " + path);
+        }
+
+        Trace trace;
+        trace.capacity = header.capacity;
+        TraceEvent ev;
+        while (std::fread(&ev, sizeof(ev), 1, file) == 1) {
+            trace.events.push_back(ev);
+        }
+        std::fclose(file);
+
+        std::stable_sort(trace.events.begin(), trace.events.end(),
+                         [](const TraceEvent& a, const TraceEvent& b) { return a.timestampNs < b.timestampNs; });
+        return trace;
+    }
+
+    // Most slots borrowed at once in the recording.
+    size_t peakInUse() const {
+        size_t inUse = 0;
+        size_t peak = 0;
+        std::vector<bool> held(capacity, false);
+        for (const TraceEvent& ev : events) {
+            if (ev.slot >= held.size()) continue;
+            if (ev.op == static_cast<uint8_t>(PoolEvent::Borrow) && !held[ev.slot]) {
+                held[ev.slot] = true;
+                peak = std::max(peak, ++inUse);
+            } else if (ev.op == static_cast<uint8_t>(PoolEvent::Release) && held[ev.slot]) {
+                held[ev.slot] = false;
+                --inUse;
+            }
+        }
+        return peak;
+    }
+};
+
+struct ReplayOptions {
+    // 0 replays as fast as possible; 1.0 honours recorded timing, 2.0 runs twice as fast.
+    double speed = 0;
+};
+
+struct ReplayResult {
+    uint64_t borrows = 0;     // Successful borrows
+    uint64_t timeouts = 0;    // Borrows that threw
+    uint64_t waits = 0;       // Borrows slower than kWaitThresholdNs, i.e. that most likely blocked
+    double seconds = 0;       // Wall time of the replay
+    size_t peakInUse = 0;     // Most messages held at once during the replay
+    HistogramSnapshot borrowTime; // Nanoseconds spent inside borrow()
+
+    static constexpr uint64_t kWaitThresholdNs = 10000;
+
+    double throughput() const { return seconds > 0 ? static_cast<double>(borrows) / seconds : 0; }
+};
+
+// Drives any pool with borrow()/release(NetworkMessage*) through a recorded
+// trace. Each recorded thread becomes a replay thread performing the same
+// borrows and releases in the same order; a message released on a different
+// thread than it was borrowed on is handed across, the release waiting until
+// the matching borrow has happened.
+template <class Pool>
+ReplayResult replayTrace(Pool& pool, const Trace& trace, ReplayOptions options = {}) {
+    struct Op {
+        uint64_t timestampNs;
+        size_t instance; // Index of the borrow this op refers to
+        bool borrow;
+    };
+
+    // Pair every release with the borrow of the same slot before it
+    std::unordered_map<uint16_t, std::vector<Op>> perThread;
+    std::unordered_map<uint32_t, size_t> outstanding; // slot -> borrow instance
+    std::vector<bool> released;
+    size_t instances = 0;
+    for (const TraceEvent& ev : trace.events) {
+        if (ev.op == static_cast<uint8_t>(PoolEvent::Borrow)) {
+            outstanding[ev.slot] = instances;
+            perThread[ev.thread].push_back({ev.timestampNs, instances, true});
+            released.push_back(false);
+            ++instances;
+        } else if (ev.op == static_cast<uint8_t>(PoolEvent::Release)) {
+            auto it = outstanding.find(ev.slot);
+            if (it == outstanding.end()) continue; // Borrowed before recording began
+            perThread[ev.thread].push_back({ev.timestampNs, it->second, false});
+            released[it->second] = true;
+            outstanding.erase(it);
+        }
+    }
+
+    using Message = decltype(pool.borrow());
+    static const uintptr_t kFailed = 1;
+    std::vector<std::atomic<uintptr_t>> handoff(instances);
+    for (auto& h : handoff) h.store(0, std::memory_order_relaxed);
+
+    LatencyHistogram borrowTime;
+    std::atomic<uint64_t> borrows{0}, timeouts{0}, waits{0};
+    std::atomic<size_t> inUse{0}, peak{0};
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (auto& entry : perThread) {
+        const std::vector<Op>* ops = &entry.second;
+        threads.emplace_back([&, ops]() {
+            for (const Op& op : *ops) {
+                if (options.speed > 0) {
+                    auto due = start + std::chrono::nanoseconds(
+                        static_cast<uint64_t>(static_cast<double>(op.timestampNs) / options.speed));
+                    std::this_thread::sleep_until(due);
+                }
+
+                if (op.borrow) {
+                    auto before = std::chrono::steady_clock::now();
+                    uintptr_t result = kFailed;
+                    try {
+                        result = reinterpret_cast<uintptr_t>(pool.borrow());
+                        ++borrows;
+                        size_t now = ++inUse;
+                        size_t seen = peak.load(std::memory_order_relaxed);
+                        while (now > seen && !peak.compare_exchange_weak(seen, now)) {}
+                    } catch (const std::runtime_error&) {
+                        ++timeouts;
+                    }
+                    uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - before).count());
+                    borrowTime.record(ns);
+                    if (ns > ReplayResult::kWaitThresholdNs) ++waits;
+                    handoff[op.instance].store(result, std::memory_order_release);
+                } else {
+                    uintptr_t msg;
+                    while ((msg = handoff[op.instance].load(std::memory_order_acquire)) == 0) {
+                        std::this_thread::yield();
+                    }
+                    if (msg != kFailed) {
+                        --inUse;
+                        pool.release(reinterpret_cast<Message>(msg));
+                    }
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    // Messages the trace never released go back so the pool ends clean
+    for (size_t i = 0; i < instances; ++i) {
+        uintptr_t msg = handoff[i].load(std::memory_order_relaxed);
+        if (!released[i] && msg != kFailed) {
+            pool.release(reinterpret_cast<Message>(msg));
+        }
+    }
+
+    ReplayResult result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.borrows = borrows;
+    result.timeouts = timeouts;
+    result.waits = waits;
+    result.peakInUse = peak;
+    result.borrowTime = borrowTime.snapshot();
+    return result;
+}
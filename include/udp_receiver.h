@@ -0,0 +1,91 @@
+#pragma once
+
+#include "message_pool.h"
+#include <vector>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <sys/socket.h>
+
+// Receives datagrams straight into pooled messages: one recvmmsg() call per
+// batch, with each iovec pointing at a borrowed message's payload.
+class UdpReceiver {
+public:
+    UdpReceiver(MessagePool& pool, int fd, size_t batchSize = 32)
+        : pool_(pool), fd_(fd), slots_(batchSize), iovecs_(batchSize), headers_(batchSize) {
+        if (batchSize == 0) {
+            throw std::invalid_argument("Batch size must be positive");
+        }
+    }
+
+    // Appends received messages to out and returns how many arrived. Each one
+    // carries its length, a receive timestamp and a per-receiver sequence
+    // number; the caller must release it. Slots the kernel didn't fill, and
+    // datagrams too large for a payload (see truncated()), are handed straight
+    // back to the pool. With the default MSG_DONTWAIT an empty
+    // socket returns 0.
+    size_t receive(std::vector<NetworkMessage*>& out, int flags = MSG_DONTWAIT) {
+        size_t borrowed = pool_.borrowBatch(slots_.data(), slots_.size());
+
+        for (size_t i = 0; i < borrowed; ++i) {
+            iovecs_[i].iov_base = slots_[i]->data;
+            iovecs_[i].iov_len = sizeof(slots_[i]->data);
+            std::memset(&headers_[i], 0, sizeof(headers_[i]));
+            headers_[i].msg_hdr.msg_iov = &iovecs_[i];
+            headers_[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int received = ::recvmmsg(fd_, headers_.data(), static_cast<unsigned>(borrowed), flags, nullptr);
+        if (received < 0) {
+            int err = errno;
+            pool_.releaseBatch(slots_.data(), borrowed);
+            if (err == EAGAIN || err == EWOULDBLOCK || err == EINTR) {
+                return 0;
+            }
+            throw std::runtime_error(std::string("recvmmsg failed: ") + std::strerror(err));
+        }
+
+        timespec now;
+        ::clock_gettime(CLOCK_REALTIME, &now);
+        uint64_t timestamp = static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + static_cast<uint64_t>(now.tv_nsec);
+
+        // Datagrams cut short by the payload size are dropped, not delivered
+        // with length capped at sizeof(data). They collect at the front of
+        // slots_, whose entries before i have already been handed out.
+        size_t count = static_cast<size_t>(received);
+        size_t dropped = 0;
+        for (size_t i = 0; i < count; ++i) {
+            NetworkMessage* msg = slots_[i];
+            if (headers_[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                slots_[i] = slots_[dropped];
+                slots_[dropped++] = msg;
+                continue;
+            }
+            msg->length = static_cast<uint16_t>(headers_[i].msg_len);
+            msg->sequence = nextSequence_++;
+            msg->timestamp = timestamp;
+            out.push_back(msg);
+        }
+        if (dropped > 0) {
+            truncated_ += dropped;
+            pool_.releaseBatch(slots_.data(), dropped);
+        }
+        pool_.releaseBatch(slots_.data() + count, borrowed - count);
+        return count - dropped;
+    }
+
+    size_t batchSize() const { return slots_.size(); }
+
+    // Datagrams dropped so far for not fitting in a message payload.
+    uint64_t truncated() const { return truncated_; }
+
+private:
+    MessagePool& pool_;
+    int fd_;
+    uint64_t nextSequence_ = 0;
+    uint64_t truncated_ = 0;
+    std::vector<NetworkMessage*> slots_;
+    std::vector<iovec> iovecs_;
+    std::vector<mmsghdr> headers_;
+};
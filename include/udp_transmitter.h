@@ -0,0 +1,206 @@
+#pragma once
+
+#include "message_pool.h"
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <exception>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// Sends pooled messages without copying them into a separate buffer; each
+// message goes out as its first msg->length payload bytes. Datagram
+// sockets get one sendmmsg() per batch; anything else (stream sockets, pipes)
+// gets one writev() per batch. Messages go back to the pool once the kernel has
+// taken them. Whatever the kernel doesn't accept (EAGAIN on a non-blocking fd)
+// stays queued, including a partially written stream message, and goes out on
+// the next flush(). A datagram the kernel rejects outright (EMSGSIZE,
+// EDESTADDRREQ and the like) is released and counted in dropped() before the
+// error is thrown, so the rest of the queue still goes out; ECONNREFUSED,
+// which reports an earlier datagram's fate, leaves the queue as it is.
+class UdpTransmitter {
+public:
+    UdpTransmitter(MessagePool& pool, int fd, size_t batchSize = 32)
+        : pool_(pool), fd_(fd), batchSize_(std::min<size_t>(batchSize, IOV_MAX)),
+          iovecs_(batchSize_), headers_(batchSize_) {
+        if (batchSize_ == 0) {
+            throw std::invalid_argument("Batch size must be positive");
+        }
+
+        int type = 0;
+        socklen_t len = sizeof(type);
+        datagram_ = ::getsockopt(fd_, SOL_SOCKET, SO_TYPE, &type, &len) == 0 &&
+                    (type == SOCK_DGRAM || type == SOCK_SEQPACKET);
+    }
+
+    // Messages the pool refuses (released behind the transmitter's back) are
+    // skipped: there is no one to report them to from here.
+    ~UdpTransmitter() {
+        try {
+            dropPending();
+        } catch (const std::exception&) {
+        }
+    }
+
+    // Takes ownership of msg, which must be borrowed from this transmitter's pool.
+    void enqueue(NetworkMessage* msg) {
+        check(msg);
+        queue_.push_back(msg);
+    }
+
+    // Queues the batch and flushes; returns how many messages were sent.
+    size_t send(NetworkMessage* const* batch, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            check(batch[i]);
+        }
+        queue_.insert(queue_.end(), batch, batch + count);
+        return flush();
+    }
+
+    // Sends as much of the queue as the kernel takes, releasing every message
+    // it has fully consumed. Returns how many messages were completed.
+    size_t flush() {
+        size_t sent = 0;
+        try {
+            sent = datagram_ ? flushDatagrams() : flushStream();
+        } catch (...) {
+            compact();
+            throw;
+        }
+        compact();
+        return sent;
+    }
+
+    // Messages still waiting for the kernel, including one partially written.
+    size_t pending() const { return queue_.size() - head_; }
+
+    // Datagrams released unsent after the kernel rejected them.
+    uint64_t dropped() const { return dropped_; }
+
+    // Gives every unsent message back to the pool. If the pool refuses one,
+    // the rest are still released and the first error is rethrown.
+    void dropPending() {
+        std::exception_ptr error;
+        for (size_t i = head_; i < queue_.size(); ++i) {
+            try {
+                pool_.release(queue_[i]);
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        queue_.clear();
+        head_ = 0;
+        offset_ = 0;
+        if (error) std::rethrow_exception(error);
+    }
+
+private:
+    // Catches foreign messages up front, where the caller can still handle
+    // them, rather than when a release fails later.
+    void check(const NetworkMessage* msg) const {
+        const char* base = reinterpret_cast<const char*>(pool_.slab());
+        const char* addr = reinterpret_cast<const char*>(msg);
+        size_t offset = static_cast<size_t>(addr - base);
+        if (addr < base || offset >= pool_.capacity() * MessagePool::slotStride() ||
+            offset % MessagePool::slotStride() != 0) {
+            throw std::invalid_argument("Message does not belong to this pool");
+        }
+        if (msg->length > sizeof(msg->data)) {
+            throw std::invalid_argument("Message length exceeds payload size");
+        }
+    }
+
+    size_t flushDatagrams() {
+        size_t sent = 0;
+        while (head_ < queue_.size()) {
+            size_t n = std::min(batchSize_, queue_.size() - head_);
+            for (size_t i = 0; i < n; ++i) {
+                NetworkMessage* msg = queue_[head_ + i];
+                iovecs_[i].iov_base = msg->data;
+                iovecs_[i].iov_len = msg->length;
+                std::memset(&headers_[i], 0, sizeof(headers_[i]));
+                headers_[i].msg_hdr.msg_iov = &iovecs_[i];
+                headers_[i].msg_hdr.msg_iovlen = 1;
+            }
+
+            int result = ::sendmmsg(fd_, headers_.data(), static_cast<unsigned>(n), MSG_NOSIGNAL);
+            if (result < 0) {
+                int err = errno;
+                if (err == EINTR) continue;
+                if (err == EAGAIN || err == EWOULDBLOCK || err == ENOBUFS) break;
+                // sendmmsg() only fails outright on the first datagram
+                if (err != ECONNREFUSED) {
+                    ++dropped_;
+                    releaseFront(1);
+                }
+                throw std::runtime_error(std::string("sendmmsg failed: ") + std::strerror(err));
+            }
+
+            releaseFront(static_cast<size_t>(result));
+            sent += static_cast<size_t>(result);
+            if (static_cast<size_t>(result) < n) break; // Kernel took only part of the batch
+        }
+        return sent;
+    }
+
+    size_t flushStream() {
+        size_t sent = 0;
+        while (head_ < queue_.size()) {
+            size_t n = std::min(batchSize_, queue_.size() - head_);
+            for (size_t i = 0; i < n; ++i) {
+                NetworkMessage* msg = queue_[head_ + i];
+                size_t skip = i == 0 ? offset_ : 0;
+                iovecs_[i].iov_base = msg->data + skip;
+                iovecs_[i].iov_len = msg->length - skip;
+            }
+
+            ssize_t written = ::writev(fd_, iovecs_.data(), static_cast<int>(n));
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                throw std::runtime_error(std::string("writev failed: ") + std::strerror(errno));
+            }
+
+            // Retire whole messages; remember how far into the next one we got
+            size_t remaining = static_cast<size_t>(written);
+            size_t completed = 0;
+            while (completed < n) {
+                size_t left = queue_[head_ + completed]->length - (completed == 0 ? offset_ : 0);
+                if (remaining < left) break;
+                remaining -= left;
+                ++completed;
+            }
+            offset_ = (completed == 0 ? offset_ : 0) + remaining;
+
+            releaseFront(completed);
+            sent += completed;
+            if (completed < n) break;
+        }
+        return sent;
+    }
+
+    void releaseFront(size_t count) {
+        NetworkMessage* const* done = queue_.data() + head_;
+        head_ += count; // Done with either way: a refused release mustn't resend them
+        pool_.releaseBatch(done, count);
+    }
+
+    void compact() {
+        queue_.erase(queue_.begin(), queue_.begin() + static_cast<std::ptrdiff_t>(head_));
+        head_ = 0;
+    }
+
+    MessagePool& pool_;
+    int fd_;
+    size_t batchSize_;
+    bool datagram_ = false;
+    std::vector<NetworkMessage*> queue_;
+    size_t head_ = 0;   // First unsent message in queue_
+    size_t offset_ = 0; // Bytes of queue_[head_] already written (stream only)
+    uint64_t dropped_ = 0;
+    std::vector<iovec> iovecs_;
+    std::vector<mmsghdr> headers_;
+};
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "message_pool.h"
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+struct UringCompletion {
+    NetworkMessage* msg; // The message the read landed in; length is set on success
+    size_t index;        // Its slot index in the pool
+    int result;          // Bytes read, or -errno
+};
+
+// io_uring backend that registers the pool slab as fixed buffers, so reads
+// land directly in pooled messages via IORING_OP_READ_FIXED without the
+// kernel pinning pages per request. The kernel caps a fixed buffer at 1 GiB,
+// so the slab is split into runs of whole slots no larger than that and each
+// read names the run its message falls in. Long-term pinning also refuses
+// pages of regular files: a file-backed pool registers only when its file is
+// on tmpfs (/dev/shm) or hugetlbfs. Talks to the kernel through raw
+// syscalls; construction throws if io_uring is unavailable.
+class UringReader {
+public:
+    static constexpr size_t kMaxFixedBuffer = size_t(1) << 30;
+
+    // maxBufferBytes bounds each registered run; it is rounded down to whole
+    // slots and exists mainly so tests can force several runs.
+    explicit UringReader(MessagePool& pool, unsigned entries = 64, size_t maxBufferBytes = kMaxFixedBuffer)
+        : pool_(pool),
+          slotsPerBuffer_(std::max<size_t>(1, std::min(maxBufferBytes, kMaxFixedBuffer) / MessagePool::slotStride())) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ringFd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (ringFd_ < 0) {
+            throw std::runtime_error(std::string("io_uring_setup failed: ") + std::strerror(errno));
+        }
+
+        try {
+            mapRings(params);
+            std::vector<iovec> runs;
+            for (size_t first = 0; first < pool_.capacity(); first += slotsPerBuffer_) {
+                size_t count = std::min(slotsPerBuffer_, pool_.capacity() - first);
+                runs.push_back({pool_.slotAt(first), count * MessagePool::slotStride()});
+            }
+            if (::syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_BUFFERS,
+                          runs.data(), static_cast<unsigned>(runs.size())) < 0) {
+                std::string reason = std::strerror(errno);
+                if (pool_.fileBacked()) {
+                    reason += " (file-backed pools must live on tmpfs or hugetlbfs)";
+                }
+                throw std::runtime_error("Failed to register pool buffers: " + reason);
+            }
+            bufferCount_ = runs.size();
+        } catch (...) {
+            unmapRings();
+            ::close(ringFd_);
+            throw;
+        }
+    }
+
+    UringReader(const UringReader&) = delete;
+    UringReader& operator=(const UringReader&) = delete;
+
+    ~UringReader() {
+        unmapRings();
+        ::close(ringFd_);
+    }
+
+    // Number of fixed buffers the slab was registered as.
+    size_t bufferCount() const { return bufferCount_; }
+
+    // Queues a read into msg, which must be borrowed from this reader's pool.
+    // An offset of -1 reads from the current file position (or a socket).
+    void submitRead(int fd, NetworkMessage* msg, uint64_t offset = static_cast<uint64_t>(-1)) {
+        size_t index = indexOf(msg);
+
+        unsigned tail = *sqTail_;
+        if (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) == sqEntries_) {
+            submit();
+            if (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) == sqEntries_) {
+                throw std::runtime_error("io_uring submission queue full");
+            }
+        }
+
+        unsigned slot = tail & sqMask_;
+        io_uring_sqe* sqe = &sqes_[slot];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(msg->data);
+        sqe->len = sizeof(msg->data);
+        sqe->off = offset;
+        sqe->buf_index = static_cast<uint16_t>(index / slotsPerBuffer_);
+        sqe->user_data = index;
+
+        sqArray_[slot] = slot;
+        __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+        ++pending_;
+    }
+
+    // Hands queued reads to the kernel; returns how many were accepted.
+    unsigned submit() {
+        if (pending_ == 0) return 0;
+        int submitted = enter(pending_, 0, 0);
+        pending_ -= static_cast<unsigned>(submitted);
+        return static_cast<unsigned>(submitted);
+    }
+
+    // Submits anything queued, waits for at least minComplete completions and
+    // appends every available one to out. Returns how many were appended.
+    size_t wait(std::vector<UringCompletion>& out, unsigned minComplete = 1) {
+        if (pending_ > 0 || minComplete > 0) {
+            int submitted = enter(pending_, minComplete, minComplete > 0 ? IORING_ENTER_GETEVENTS : 0);
+            pending_ -= static_cast<unsigned>(submitted);
+        }
+
+        size_t count = 0;
+        unsigned head = *cqHead_;
+        while (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+            const io_uring_cqe& cqe = cqes_[head & cqMask_];
+            size_t index = static_cast<size_t>(cqe.user_data);
+            NetworkMessage* msg = pool_.slotAt(index);
+            if (cqe.res >= 0) {
+                msg->length = static_cast<uint16_t>(cqe.res);
+            }
+            out.push_back({msg, index, cqe.res});
+            ++head;
+            ++count;
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+private:
+    size_t indexOf(const NetworkMessage* msg) const {
+        const char* base = reinterpret_cast<const char*>(pool_.slab());
+        const char* addr = reinterpret_cast<const char*>(msg);
+        size_t offset = static_cast<size_t>(addr - base);
+        if (addr < base || offset >= pool_.capacity() * MessagePool::slotStride() ||
+            offset % MessagePool::slotStride() != 0) {
+            throw std::runtime_error("Message does not belong to this pool");
+        }
+        return offset / MessagePool::slotStride();
+    }
+
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags) {
+        for (;;) {
+            int ret = static_cast<int>(::syscall(__NR_io_uring_enter, ringFd_, toSubmit, minComplete,
+                                                 flags, nullptr, 0));
+            if (ret >= 0) return ret;
+            if (errno != EINTR) {
+                throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+            }
+        }
+    }
+
+    void mapRings(const io_uring_params& params) {
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap) {
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        }
+
+        sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ringFd_, IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED) {
+            sqRing_ = nullptr;
+            throw std::runtime_error("Failed to map io_uring submission ring");
+        }
+        if (singleMmap) {
+            cqRing_ = sqRing_;
+        } else {
+            cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             ringFd_, IORING_OFF_CQ_RING);
+            if (cqRing_ == MAP_FAILED) {
+                cqRing_ = nullptr;
+                throw std::runtime_error("Failed to map io_uring completion ring");
+            }
+        }
+
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ringFd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            throw std::runtime_error("Failed to map io_uring submission entries");
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        char* sq = static_cast<char*>(sqRing_);
+        sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqEntries_ = params.sq_entries;
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        char* cq = static_cast<char*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    void unmapRings() {
+        if (sqes_) ::munmap(sqes_, sqesSize_);
+        if (cqRing_ && cqRing_ != sqRing_) ::munmap(cqRing_, cqRingSize_);
+        if (sqRing_) ::munmap(sqRing_, sqRingSize_);
+    }
+
+    MessagePool& pool_;
+    size_t slotsPerBuffer_;
+    size_t bufferCount_ = 0;
+    int ringFd_ = -1;
+    unsigned pending_ = 0;
+
+    void* sqRing_ = nullptr;
+    void* cqRing_ = nullptr;
+    size_t sqRingSize_ = 0;
+    size_t cqRingSize_ = 0;
+    size_t sqesSize_ = 0;
+
+    io_uring_sqe* sqes_ = nullptr;
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned sqEntries_ = 0;
+
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
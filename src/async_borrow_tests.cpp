@@ -0,0 +1,162 @@
+#include "async_borrow.h"
+#include <gtest/gtest.h>
+
+#ifdef MESSAGE_POOL_HAVE_COROUTINES
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <string>
+#include <utility>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+// Single-threaded run queue standing in for an event loop.
+struct ManualExecutor {
+    std::deque<std::function<void()>> queue;
+
+    void post(std::function<void()> f) { queue.push_back(std::move(f)); }
+
+    void runAll() {
+        while (!queue.empty()) {
+            auto f = std::move(queue.front());
+            queue.pop_front();
+            f();
+        }
+    }
+};
+
+// Eagerly started coroutine, destroyed with the Task.
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return Task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    ~Task() {
+        if (handle) handle.destroy();
+    }
+
+    bool done() const { return handle.done(); }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+Task borrowInto(MessagePool& pool, ManualExecutor& executor, NetworkMessage** out) {
+    *out = co_await asyncBorrow(pool, executor);
+}
+
+Task borrowOrError(MessagePool& pool, ManualExecutor& executor, std::string* error) {
+    try {
+        pool.release(co_await asyncBorrow(pool, executor));
+    } catch (const std::runtime_error& e) {
+        *error = e.what();
+    }
+}
+
+} // namespace
+
+TEST(AsyncBorrowTest, CompletesImmediatelyWhenFree) {
+    MessagePool pool(2);
+    ManualExecutor executor;
+    NetworkMessage* msg = nullptr;
+
+    Task task = borrowInto(pool, executor, &msg);
+    EXPECT_TRUE(task.done());
+    ASSERT_NE(msg, nullptr);
+    EXPECT_TRUE(executor.queue.empty());
+    EXPECT_EQ(pool.available(), 1u);
+    pool.release(msg);
+}
+
+TEST(AsyncBorrowTest, ResumesOnExecutorAfterRelease) {
+    MessagePool pool(1);
+    ManualExecutor executor;
+    auto* held = pool.borrow();
+    NetworkMessage* msg = nullptr;
+
+    Task task = borrowInto(pool, executor, &msg);
+    EXPECT_FALSE(task.done());
+    EXPECT_TRUE(executor.queue.empty());
+
+    pool.release(held);
+    EXPECT_EQ(pool.available(), 0u);  // Handed to the coroutine
+    EXPECT_EQ(msg, nullptr);          // ...which only runs on its executor
+    ASSERT_EQ(executor.queue.size(), 1u);
+
+    executor.runAll();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(msg, held);
+    EXPECT_EQ(pool.stats().waits, 1u);
+    EXPECT_EQ(pool.waitHistogram().count(), 1u);
+    pool.release(msg);
+}
+
+TEST(AsyncBorrowTest, SyncBorrowersQueueBehindCoroutine) {
+    MessagePool pool(1, 1ms);
+    ManualExecutor executor;
+    auto* held = pool.borrow();
+    NetworkMessage* msg = nullptr;
+
+    Task task = borrowInto(pool, executor, &msg);
+    pool.release(held);
+    EXPECT_EQ(pool.tryBorrow(), nullptr);
+    EXPECT_THROW(pool.borrow(), std::runtime_error);
+
+    executor.runAll();
+    EXPECT_EQ(msg, held);
+    pool.release(msg);
+}
+
+TEST(AsyncBorrowTest, DestroyingSuspendedCoroutineGivesBackItsPlace) {
+    MessagePool pool(1);
+    ManualExecutor executor;
+    auto* held = pool.borrow();
+    NetworkMessage* msg = nullptr;
+
+    {
+        Task queued = borrowInto(pool, executor, &msg);
+    }
+    pool.release(held);
+    EXPECT_EQ(pool.available(), 1u);
+    EXPECT_TRUE(executor.queue.empty());
+
+    // Handed a slot but destroyed before the executor resumed it
+    held = pool.borrow();
+    {
+        Task handed = borrowInto(pool, executor, &msg);
+        pool.release(held);
+        EXPECT_EQ(pool.available(), 0u);
+    }
+    executor.queue.clear();
+    EXPECT_EQ(pool.available(), 1u);
+    EXPECT_EQ(msg, nullptr);
+}
+
+TEST(AsyncBorrowTest, ShutdownResumesWithError) {
+    MessagePool pool(1);
+    ManualExecutor executor;
+    auto* held = pool.borrow();
+    std::string error;
+
+    Task task = borrowOrError(pool, executor, &error);
+    pool.shutdown();
+    executor.runAll();
+    EXPECT_TRUE(task.done());
+    EXPECT_EQ(error, "Message pool is shut down");
+
+    error.clear();
+    Task late = borrowOrError(pool, executor, &error); // Fails without suspending
+    EXPECT_TRUE(late.done());
+    EXPECT_EQ(error, "Message pool is shut down");
+    pool.release(held);
+}
+
+#endif
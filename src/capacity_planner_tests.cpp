@@ -0,0 +1,62 @@
+#include "capacity_planner.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+TraceEvent event(uint64_t ts, PoolEvent op, uint32_t slot) {
+    return {ts, slot, 0, static_cast<uint8_t>(op), 0};
+}
+
+} // namespace
+
+TEST(CapacityPlannerTest, ErlangC) {
+    EXPECT_NEAR(CapacityPlanner::erlangC(1, 0.5), 0.5, 1e-9);  // M/M/1: utilization
+    EXPECT_NEAR(CapacityPlanner::erlangC(2, 1.0), 1.0 / 3, 1e-9);
+    EXPECT_EQ(CapacityPlanner::erlangC(2, 2.0), 1.0);           // Saturated
+    EXPECT_EQ(CapacityPlanner::erlangC(4, 0.0), 0.0);
+    EXPECT_LT(CapacityPlanner::erlangC(20, 10.0), 0.01);
+}
+
+TEST(CapacityPlannerTest, FromTrace) {
+    // Demand seen at borrows: 0, 1, 2, then 0 again
+    Trace trace;
+    trace.capacity = 4;
+    trace.events = {
+        event(1, PoolEvent::Borrow, 0), event(2, PoolEvent::Borrow, 1), event(3, PoolEvent::Borrow, 2),
+        event(4, PoolEvent::Release, 0), event(5, PoolEvent::Release, 1), event(6, PoolEvent::Release, 2),
+        event(7, PoolEvent::Borrow, 3), event(8, PoolEvent::Release, 3),
+    };
+
+    CapacityPlanner planner = CapacityPlanner::fromTrace(trace);
+    EXPECT_FALSE(planner.saturated());
+    EXPECT_DOUBLE_EQ(planner.waitProbability(1), 0.5);
+    EXPECT_DOUBLE_EQ(planner.waitProbability(2), 0.25);
+    EXPECT_DOUBLE_EQ(planner.waitProbability(3), 0.0);
+
+    CapacityOption option = planner.recommend(0.3);
+    EXPECT_EQ(option.capacity, 2u);
+    EXPECT_EQ(option.footprintBytes, MessagePool::footprint(2));
+    EXPECT_EQ(planner.recommend(0.0).capacity, 3u);
+}
+
+TEST(CapacityPlannerTest, SaturatedTraceFlagged) {
+    Trace trace;
+    trace.capacity = 1;
+    trace.events = {event(1, PoolEvent::Borrow, 0), event(2, PoolEvent::Wait, 0), event(3, PoolEvent::Release, 0)};
+    EXPECT_TRUE(CapacityPlanner::fromTrace(trace).saturated());
+}
+
+TEST(CapacityPlannerTest, FromRates) {
+    // 10k borrows/s held 1ms each: 10 messages in use on average
+    CapacityPlanner planner = CapacityPlanner::fromRates(10000, 1e6);
+    EXPECT_DOUBLE_EQ(planner.offeredLoad(), 10.0);
+    CapacityOption option = planner.recommend(0.01);
+    EXPECT_GT(option.capacity, 10u);
+    EXPECT_LE(option.waitProbability, 0.01);
+    EXPECT_GT(planner.waitProbability(option.capacity - 1), 0.01);
+}
+
+TEST(CapacityPlannerTest, FootprintGrowsWithCapacity) {
+    EXPECT_GE(MessagePool::footprint(100), 100 * sizeof(NetworkMessage));
+    EXPECT_LT(MessagePool::footprint(100), MessagePool::footprint(101));
+}
@@ -0,0 +1,184 @@
+// epoll_example: a single-threaded ingest loop that multiplexes a UDP socket
+// with MessagePool::availableFd(). When the pool runs dry the loop stops
+// reading the socket (the kernel buffers or drops the excess) and waits for
+// the pool to refill, instead of blocking in borrow().
+//
+// A sender thread blasts datagrams at the socket and a deliberately slow
+// worker releases the messages, so the pool empties and refills repeatedly.
+//
+// Usage: epoll_example [--messages N] [--capacity N]
+
+#include "message_pool.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Stands in for downstream processing: releases each message after a delay.
+class SlowWorker {
+public:
+    explicit SlowWorker(MessagePool& pool) : pool_(pool), thread_([this]() { run(); }) {}
+
+    ~SlowWorker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+    void push(NetworkMessage* msg) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(msg);
+        }
+        cv_.notify_one();
+    }
+
+    uint64_t processed() const { return processed_.load(); }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            NetworkMessage* msg = queue_.front();
+            queue_.pop_front();
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            pool_.release(msg);
+            ++processed_;
+            lock.lock();
+        }
+    }
+
+    MessagePool& pool_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<NetworkMessage*> queue_;
+    bool stop_ = false;
+    std::atomic<uint64_t> processed_{0};
+    std::thread thread_;
+};
+
+void setInterest(int epfd, int fd, uint32_t events) {
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    ::epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint64_t messages = 2000;
+    size_t capacity = 16;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--messages") == 0) {
+            messages = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--capacity") == 0) {
+            capacity = std::strtoul(argv[i + 1], nullptr, 10);
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            return 2;
+        }
+    }
+
+    int sock = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (sock < 0 || ::bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::getsockname(sock, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        std::perror("socket");
+        return 1;
+    }
+
+    MessagePool pool(capacity);
+    SlowWorker worker(pool);
+
+    int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+    int poolFd = pool.availableFd();
+    for (int fd : {sock, poolFd}) {
+        epoll_event ev{};
+        ev.events = fd == sock ? static_cast<uint32_t>(EPOLLIN) : 0u; // Pool fd is only watched while paused
+        ev.data.fd = fd;
+        ::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    // Sender: paced in bursts, still faster than the worker drains the pool
+    std::thread sender([&]() {
+        int out = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        char payload[64] = "market data";
+        for (uint64_t i = 0; i < messages; ++i) {
+            ::sendto(out, payload, sizeof(payload), 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+            if (i % 16 == 15) std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        ::close(out);
+    });
+
+    uint64_t received = 0;
+    uint64_t pauses = 0;
+    bool paused = false;
+    epoll_event events[2];
+    for (;;) {
+        int n = ::epoll_wait(epfd, events, 2, 200);
+        if (n == 0) break; // Idle: the sender is done
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.fd == poolFd) {
+                // Slots are back: resume reading
+                paused = false;
+                setInterest(epfd, poolFd, 0);
+                setInterest(epfd, sock, EPOLLIN);
+                continue;
+            }
+
+            while (!paused) {
+                NetworkMessage* msg = pool.tryBorrow();
+                if (!msg) {
+                    // Pool exhausted: park the socket until availableFd() fires
+                    paused = true;
+                    ++pauses;
+                    setInterest(epfd, sock, 0);
+                    setInterest(epfd, poolFd, EPOLLIN);
+                    break;
+                }
+                ssize_t got = ::recv(sock, msg->data, sizeof(msg->data), MSG_DONTWAIT);
+                if (got < 0) {
+                    pool.release(msg);
+                    if (errno != EAGAIN && errno != EWOULDBLOCK) std::perror("recv");
+                    break;
+                }
+                msg->length = static_cast<uint16_t>(got);
+                msg->sequence = ++received;
+                worker.push(msg);
+            }
+        }
+    }
+    sender.join();
+
+    // Whatever was not received overflowed the socket buffer while paused
+    std::printf("received %llu of %llu datagrams, paused %llu times on an empty pool of %zu\n",
+                static_cast<unsigned long long>(received), static_cast<unsigned long long>(messages),
+                static_cast<unsigned long long>(pauses), capacity);
+    std::printf("processed %llu\n", static_cast<unsigned long long>(worker.processed()));
+    ::close(epfd);
+    ::close(sock);
+    return 0;
+}
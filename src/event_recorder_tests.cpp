@@ -0,0 +1,97 @@
+#include "message_pool.h"
+#include "trace_replay.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+std::string tracePath(const char* test) {
+    return ::testing::TempDir() + "trace_" + test + "_" + std::to_string(::getpid()) + ".bin";
+}
+
+} // namespace
+
+TEST(EventRecorderTest, RecordsBorrowAndRelease) {
+    std::string path = tracePath("record");
+    MessagePool pool(2, 1ms);
+    {
+        EventRecorder recorder(path, pool.capacity());
+        pool.setRecorder(&recorder);
+
+        auto* a = pool.borrow();
+        auto* b = pool.borrow();
+        EXPECT_THROW(pool.borrow(), std::runtime_error);
+        pool.release(a);
+        pool.release(b);
+
+        pool.setRecorder(nullptr);
+        EXPECT_EQ(recorder.dropped(), 0u);
+    }
+
+    Trace trace = Trace::load(path);
+    EXPECT_EQ(trace.capacity, 2u);
+    ASSERT_EQ(trace.events.size(), 6u);
+
+    std::vector<uint8_t> ops;
+    for (const auto& ev : trace.events) ops.push_back(ev.op);
+    std::vector<uint8_t> expected = {
+        static_cast<uint8_t>(PoolEvent::Borrow), static_cast<uint8_t>(PoolEvent::Borrow),
+        static_cast<uint8_t>(PoolEvent::Wait), static_cast<uint8_t>(PoolEvent::Timeout),
+        static_cast<uint8_t>(PoolEvent::Release), static_cast<uint8_t>(PoolEvent::Release)};
+    EXPECT_EQ(ops, expected);
+    EXPECT_EQ(trace.events[0].slot, 0u);
+    EXPECT_EQ(trace.events[1].slot, 1u);
+    EXPECT_GE(trace.events[3].timestampNs - trace.events[2].timestampNs, 1000000u);
+    EXPECT_EQ(trace.peakInUse(), 2u);
+    ::unlink(path.c_str());
+}
+
+TEST(EventRecorderTest, FullRingDropsEvents) {
+    std::string path = tracePath("drops");
+    MessagePool pool(1);
+    EventRecorder recorder(path, pool.capacity(), 4, 1h); // Never flushes on its own
+    pool.setRecorder(&recorder);
+    for (int i = 0; i < 4; ++i) pool.release(pool.borrow());
+    pool.setRecorder(nullptr);
+    EXPECT_EQ(recorder.dropped(), 4u);
+    ::unlink(path.c_str());
+}
+
+TEST(EventRecorderTest, ReplayCrossThreadTrace) {
+    std::string path = tracePath("replay");
+    MessagePool recorded(4);
+    {
+        EventRecorder recorder(path, recorded.capacity());
+        recorded.setRecorder(&recorder);
+
+        // Borrow on one thread, release on another, as in an RX -> worker pipeline
+        std::vector<NetworkMessage*> msgs;
+        for (int round = 0; round < 50; ++round) {
+            for (int i = 0; i < 3; ++i) msgs.push_back(recorded.borrow());
+            std::thread worker([&]() {
+                for (auto* msg : msgs) recorded.release(msg);
+            });
+            worker.join();
+            msgs.clear();
+        }
+        recorded.setRecorder(nullptr);
+    }
+
+    Trace trace = Trace::load(path);
+    EXPECT_EQ(trace.events.size(), 300u);
+    EXPECT_EQ(trace.peakInUse(), 3u);
+
+    MessagePool pool(trace.capacity);
+    ReplayResult result = replayTrace(pool, trace);
+    EXPECT_EQ(result.borrows, 150u);
+    EXPECT_EQ(result.timeouts, 0u);
+    EXPECT_LE(result.peakInUse, 4u);
+    EXPECT_EQ(result.borrowTime.count(), 150u);
+    EXPECT_EQ(pool.available(), pool.capacity());
+    ::unlink(path.c_str());
+}
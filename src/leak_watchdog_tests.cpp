@@ -0,0 +1,46 @@
+#include "leak_watchdog.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+TEST(LeakWatchdogTest, ReportsEachLongHoldOnce) {
+    MessagePool pool(2);
+    std::mutex mutex;
+    std::vector<HeldMessage> reports;
+
+    auto* leaked = pool.borrow();
+    {
+        LeakWatchdog watchdog(pool, 10ms, 5ms, [&](const HeldMessage& held) {
+            std::lock_guard<std::mutex> lock(mutex);
+            reports.push_back(held);
+        });
+
+        auto* brief = pool.borrow();
+        pool.release(brief);
+        std::this_thread::sleep_for(60ms); // Several scans past the threshold
+    }
+
+    ASSERT_EQ(reports.size(), 1u);
+    EXPECT_EQ(reports[0].msg, leaked);
+    EXPECT_GE(reports[0].heldFor, 10ms);
+    pool.release(leaked);
+}
+
+TEST(LeakWatchdogTest, ReborrowedSlotReportedAgain) {
+    MessagePool pool(1);
+    std::atomic<int> reports{0};
+    LeakWatchdog watchdog(pool, 5ms, 2ms, [&](const HeldMessage&) { ++reports; });
+
+    for (int i = 0; i < 2; ++i) {
+        auto* msg = pool.borrow();
+        for (int wait = 0; wait < 200 && reports < i + 1; ++wait) {
+            std::this_thread::sleep_for(2ms);
+        }
+        pool.release(msg);
+    }
+    EXPECT_EQ(reports, 2);
+}
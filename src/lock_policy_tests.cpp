@@ -0,0 +1,67 @@
+#include "message_pool.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+template <class Policy>
+class LockPolicyTest : public ::testing::Test {};
+
+using Policies = ::testing::Types<MutexLock, SpinLock, NoLock>;
+TYPED_TEST_SUITE(LockPolicyTest, Policies);
+
+TYPED_TEST(LockPolicyTest, BorrowAndRelease) {
+    BasicMessagePool<TypeParam> pool(3, 1ms);
+    NetworkMessage* msgs[3];
+    for (auto*& msg : msgs) msg = pool.borrow();
+    EXPECT_EQ(pool.available(), 0u);
+    EXPECT_THROW(pool.borrow(), std::runtime_error);
+    EXPECT_EQ(pool.tryBorrow(), nullptr);
+
+    pool.release(msgs[1]);
+    EXPECT_EQ(pool.borrow(Priority::High), msgs[1]);
+    pool.releaseBatch(msgs, 3);
+    EXPECT_THROW(pool.release(msgs[0]), std::runtime_error); // NoLock checks without a CAS
+    EXPECT_EQ(pool.available(), 3u);
+    EXPECT_EQ(pool.stats().borrows, 4u);
+    EXPECT_EQ(pool.stats().releases, 4u);
+    EXPECT_EQ(pool.stats().timeouts, 1u);
+    EXPECT_EQ(pool.holdHistogram().count(), 4u);
+}
+
+TYPED_TEST(LockPolicyTest, PoolIdsSharedAcrossPolicies) {
+    BasicMessagePool<TypeParam> a(1);
+    MessagePool b(1);
+    EXPECT_NE(a.id(), b.id());
+}
+
+TEST(LockPolicyTest, NoLockFailsWithoutWaiting) {
+    BasicMessagePool<NoLock> pool(1, 10s);
+    pool.setFairWaiting(true);
+    auto* msg = pool.borrow();
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_THROW(pool.borrow(), std::runtime_error); // Nobody else could release it
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+    pool.release(msg);
+    EXPECT_EQ(pool.available(), 1u);
+}
+
+TEST(LockPolicyTest, SpinLockThreadSafety) {
+    BasicMessagePool<SpinLock> pool(8, 1s);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&pool]() {
+            for (int i = 0; i < 2000; ++i) {
+                auto* msg = pool.borrow();
+                msg->data[0] = static_cast<char>(i);
+                pool.release(msg);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    EXPECT_EQ(pool.available(), 8u);
+    EXPECT_EQ(pool.stats().borrows, 8000u);
+    EXPECT_EQ(pool.stats().timeouts, 0u);
+}
@@ -0,0 +1,437 @@
+// message_pool_bench: micro-benchmarks for pool policies. Not part of ctest;
+// run on an otherwise idle machine.
+//
+// Usage: message_pool_bench [name ...] [--threads N] [--capacity N] [--seconds S]
+//
+//   fairness   oversubscribed borrow/release loop, default vs fair waiting
+//   locking    borrow/release cost per locking policy, one thread and contended
+//   reuse      FIFO vs LIFO slot reuse: cache misses and latency of a decode loop
+//   prefetch   borrow-and-fill cost with and without prefetching the next slot
+//   scrub      per-message cost with a hot lookup table, by scrubbing method
+
+#include "message_pool.h"
+#include "latency_histogram.h"
+#include "cycle_clock.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+struct BenchOptions {
+    size_t threads = 16;
+    size_t capacity = 4;
+    double seconds = 2.0;
+};
+
+// Busy work standing in for message processing while a slot is held.
+void touch(NetworkMessage* msg, int rounds) {
+    for (int i = 0; i < rounds; ++i) {
+        msg->data[i & 255] = static_cast<char>(i);
+    }
+    msg->length = 64;
+}
+
+void runFairness(const BenchOptions& options) {
+    std::printf("fairness: %zu threads on %zu slots for %.1f s\n", options.threads, options.capacity, options.seconds);
+    std::printf("%-8s %12s %10s %10s %12s %14s %9s\n",
+                "mode", "borrows/s", "p50 us", "p99 us", "max us", "min/max share", "timeouts");
+
+    for (bool fair : {false, true}) {
+        MessagePool pool(options.capacity, std::chrono::seconds(1));
+        pool.setFairWaiting(fair);
+
+        LatencyHistogram borrowTime;
+        std::atomic<uint64_t> maxNs{0};
+        std::atomic<uint64_t> timeouts{0};
+        std::atomic<bool> stop{false};
+        std::vector<uint64_t> perThread(options.threads, 0);
+
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < options.threads; ++t) {
+            threads.emplace_back([&, t]() {
+                uint64_t worst = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    auto before = std::chrono::steady_clock::now();
+                    NetworkMessage* msg;
+                    try {
+                        msg = pool.borrow();
+                    } catch (const std::runtime_error&) {
+                        ++timeouts;
+                        continue;
+                    }
+                    uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - before).count());
+                    borrowTime.record(ns);
+                    worst = std::max(worst, ns);
+                    touch(msg, 512);
+                    pool.release(msg);
+                    ++perThread[t];
+                }
+                uint64_t seen = maxNs.load(std::memory_order_relaxed);
+                while (worst > seen && !maxNs.compare_exchange_weak(seen, worst)) {}
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+        stop = true;
+        for (auto& t : threads) t.join();
+
+        HistogramSnapshot snapshot = borrowTime.snapshot();
+        auto share = std::minmax_element(perThread.begin(), perThread.end());
+        std::printf("%-8s %12.0f %10.1f %10.1f %12.1f %6llu/%-7llu %9llu\n",
+                    fair ? "fair" : "default",
+                    static_cast<double>(snapshot.count()) / options.seconds,
+                    snapshot.percentile(0.50) / 1000.0, snapshot.percentile(0.99) / 1000.0,
+                    static_cast<double>(maxNs.load()) / 1000.0,
+                    static_cast<unsigned long long>(*share.first), static_cast<unsigned long long>(*share.second),
+                    static_cast<unsigned long long>(timeouts.load()));
+    }
+}
+
+// Borrow/release pairs per second on one thread, then on options.threads
+// threads sharing the pool (skipped for NoLock, which is single-threaded).
+template <class Policy>
+void runLockingPolicy(const char* name, const BenchOptions& options, bool threaded) {
+    const size_t capacity = std::max<size_t>(options.capacity, options.threads);
+    BasicMessagePool<Policy> pool(capacity, std::chrono::seconds(1));
+
+    auto measure = [&](size_t threadCount) {
+        std::atomic<bool> stop{false};
+        std::atomic<uint64_t> pairs{0};
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&]() {
+                uint64_t local = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    for (int i = 0; i < 256; ++i) {
+                        pool.release(pool.borrow());
+                    }
+                    local += 256;
+                }
+                pairs += local;
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds / 2));
+        stop = true;
+        for (auto& t : threads) t.join();
+        return static_cast<double>(pairs.load()) / (options.seconds / 2);
+    };
+
+    double single = measure(1);
+    std::printf("%-8s %14.0f %10.1f", name, single, 1e9 / single);
+    if (threaded) {
+        double shared = measure(options.threads);
+        std::printf(" %14.0f %10.1f\n", shared, 1e9 / shared);
+    } else {
+        std::printf(" %14s %10s\n", "-", "-");
+    }
+}
+
+void runLocking(const BenchOptions& options) {
+    std::printf("locking: borrow+release pairs, 1 thread and %zu threads, %.1f s\n", options.threads, options.seconds);
+    std::printf("%-8s %14s %10s %14s %10s\n", "policy", "1T pairs/s", "ns/pair", "MT pairs/s", "ns/pair");
+    runLockingPolicy<MutexLock>("mutex", options, true);
+    runLockingPolicy<SpinLock>("spin", options, true);
+    runLockingPolicy<NoLock>("none", options, false);
+}
+
+// One hardware event counted for this thread via perf_event_open. Reads as
+// -1 where the kernel or a container doesn't allow it.
+class PerfCounter {
+public:
+    PerfCounter(uint32_t type, uint64_t config) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~PerfCounter() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+
+    void start() {
+        if (fd_ < 0) return;
+        ::ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    int64_t stop() {
+        if (fd_ < 0) return -1;
+        ::ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t count = 0;
+        return ::read(fd_, &count, sizeof(count)) == sizeof(count) ? static_cast<int64_t>(count) : -1;
+    }
+
+private:
+    int fd_ = -1;
+};
+
+constexpr uint64_t cacheEvent(uint64_t cache, uint64_t result) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+}
+
+volatile uint64_t decodeSink;
+
+// Stand-in for a feed handler: a datagram lands in the payload, the decoder
+// walks its fields and stamps the header. Returns a checksum, kept in
+// decodeSink so the work can't be optimised away.
+uint64_t receiveAndDecode(NetworkMessage* msg, const char* packet, uint64_t sequence) {
+    std::memcpy(msg->data, packet, sizeof(msg->data));
+    msg->length = sizeof(msg->data);
+    uint64_t sum = 0;
+    for (size_t offset = 0; offset + sizeof(uint32_t) <= msg->length; offset += sizeof(uint32_t)) {
+        uint32_t field;
+        std::memcpy(&field, msg->data + offset, sizeof(field));
+        sum = sum * 31 + field;
+    }
+    msg->type = static_cast<uint16_t>(sum);
+    msg->sequence = sequence;
+    return sum;
+}
+
+// A pool much larger than L2 with a short in-flight window, as in a handler
+// sized for bursts: FIFO cycles through every slot, LIFO keeps reusing the
+// few just released. Latency covers borrow, decode and release of one
+// message; L2 misses are approximated by the last-level-cache counter where
+// no generic L2 event exists.
+void runReuse(const BenchOptions& options) {
+    constexpr size_t kSlots = 8192;
+    constexpr size_t kInFlight = 16;
+    std::printf("reuse: %zu-slot pool (%zu KiB), %zu in flight, %.1f s per mode\n", kSlots,
+                kSlots * MessagePool::slotStride() / 1024, kInFlight, options.seconds);
+    std::printf("%-6s %12s %12s %12s %10s %10s\n", "order", "msgs/s", "L1d miss/msg", "LLC miss/msg", "p50 ns",
+                "p99 ns");
+
+    char packet[sizeof(NetworkMessage::data)];
+    for (size_t i = 0; i < sizeof(packet); ++i) packet[i] = static_cast<char>(i * 7);
+    CycleClock::nanosPerTick();
+
+    for (ReuseOrder order : {ReuseOrder::Fifo, ReuseOrder::Lifo}) {
+        MessagePool pool(kSlots, std::chrono::seconds(1));
+        pool.setReuseOrder(order);
+        NetworkMessage* window[kInFlight] = {};
+        LatencyHistogram latency;
+        PerfCounter l1(PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS));
+        PerfCounter llc(PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS));
+
+        uint64_t sink = 0;
+        uint64_t messages = 0;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(options.seconds);
+        l1.start();
+        llc.start();
+        while (std::chrono::steady_clock::now() < deadline) {
+            for (int i = 0; i < 1024; ++i, ++messages) {
+                NetworkMessage*& slot = window[messages % kInFlight];
+                uint64_t start = CycleClock::now();
+                if (slot) pool.release(slot);
+                slot = pool.borrow();
+                sink += receiveAndDecode(slot, packet, messages);
+                latency.record(CycleClock::toNanos(CycleClock::now() - start));
+            }
+        }
+        int64_t l1Misses = l1.stop();
+        int64_t llcMisses = llc.stop();
+        for (NetworkMessage* msg : window) pool.release(msg);
+
+        auto perMessage = [&](int64_t count) {
+            return count < 0 ? std::string("-") : std::to_string(static_cast<double>(count) / messages).substr(0, 6);
+        };
+        HistogramSnapshot snapshot = latency.snapshot();
+        std::printf("%-6s %12.0f %12s %12s %10llu %10llu\n", order == ReuseOrder::Fifo ? "fifo" : "lifo",
+                    static_cast<double>(messages) / options.seconds, perMessage(l1Misses).c_str(),
+                    perMessage(llcMisses).c_str(), static_cast<unsigned long long>(snapshot.percentile(0.50)),
+                    static_cast<unsigned long long>(snapshot.percentile(0.99)));
+        decodeSink = sink;
+    }
+}
+
+// Borrow, fill the whole payload at once, release, on a FIFO pool too big to
+// stay cached, so each borrow lands on a slot last touched long ago. Single
+// borrows compare Off and Next; batches of 16 compare all three.
+void runPrefetch(const BenchOptions& options) {
+    constexpr size_t kSlots = 16384;
+    constexpr size_t kBatch = 16;
+    std::printf("prefetch: %zu-slot FIFO pool (%zu KiB), fill 256 bytes after borrow, %.1f s per mode\n", kSlots,
+                kSlots * MessagePool::slotStride() / 1024, options.seconds);
+    std::printf("%-8s %-6s %12s %10s\n", "borrow", "mode", "msgs/s", "ns/msg");
+
+    struct Mode {
+        const char* name;
+        Prefetch prefetch;
+        bool batch;
+    };
+    for (const Mode& mode : {Mode{"off", Prefetch::Off, false}, Mode{"next", Prefetch::Next, false},
+                             Mode{"off", Prefetch::Off, true}, Mode{"next", Prefetch::Next, true},
+                             Mode{"batch", Prefetch::Batch, true}}) {
+        MessagePool pool(kSlots, std::chrono::seconds(1));
+        pool.setPrefetch(mode.prefetch);
+        NetworkMessage* msgs[kBatch];
+
+        uint64_t messages = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + std::chrono::duration<double>(options.seconds);
+        while (std::chrono::steady_clock::now() < deadline) {
+            for (int round = 0; round < 64; ++round) {
+                size_t count = mode.batch ? pool.borrowBatch(msgs, kBatch) : 1;
+                if (!mode.batch) msgs[0] = pool.borrow();
+                for (size_t i = 0; i < count; ++i) {
+                    std::memset(msgs[i]->data, static_cast<int>(messages + i), sizeof(msgs[i]->data));
+                    msgs[i]->length = sizeof(msgs[i]->data);
+                }
+                pool.releaseBatch(msgs, count);
+                messages += count;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%-8s %-6s %12.0f %10.1f\n", mode.batch ? "batch" : "single", mode.name,
+                    static_cast<double>(messages) / seconds, seconds * 1e9 / static_cast<double>(messages));
+    }
+}
+
+// Each message is looked up in a 16 KiB table that should stay in L1. The
+// baseline memsets the payload before release, pulling slots from a pool
+// bigger than the cache in over the table; the pool's modes stream instead.
+// The /16 modes release and borrow the window as one batch, so the pool's
+// streaming stores drain once per batch rather than once per message.
+// "table ns" times the lookups alone, so it rises when scrubbing evicts the
+// table; L1d misses cover the whole loop.
+void runScrub(const BenchOptions& options) {
+    constexpr size_t kSlots = 16384;
+    constexpr size_t kInFlight = 16;
+    std::printf("scrub: %zu-slot pool, %zu in flight, 16 KiB hot table, %.1f s per mode\n", kSlots, kInFlight,
+                options.seconds);
+    std::printf("%-11s %12s %10s %12s %12s\n", "method", "msgs/s", "ns/msg", "table ns/msg", "L1d miss/msg");
+
+    std::vector<uint32_t> table(4096);
+    for (size_t i = 0; i < table.size(); ++i) table[i] = static_cast<uint32_t>(i * 2654435761u);
+    CycleClock::nanosPerTick();
+
+    struct Mode {
+        const char* name;
+        Scrub scrub;
+        bool memsetFirst;
+        bool batch; // The whole window is released and re-borrowed at once
+    };
+    for (const Mode& mode : {Mode{"memset", Scrub::Off, true, false}, Mode{"release", Scrub::OnRelease, false, false},
+                             Mode{"borrow", Scrub::OnBorrow, false, false},
+                             Mode{"background", Scrub::Background, false, false},
+                             Mode{"memset/16", Scrub::Off, true, true},
+                             Mode{"release/16", Scrub::OnRelease, false, true},
+                             Mode{"borrow/16", Scrub::OnBorrow, false, true}}) {
+        MessagePool pool(kSlots, std::chrono::seconds(1));
+        pool.setScrub(mode.scrub);
+        NetworkMessage* window[kInFlight] = {};
+        PerfCounter l1(PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS));
+        uint64_t sum = 0;
+        uint64_t messages = 0;
+        uint64_t tableTicks = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + std::chrono::duration<double>(options.seconds);
+        l1.start();
+        while (std::chrono::steady_clock::now() < deadline) {
+            for (int i = 0; i < 1024; ++i, ++messages) {
+                NetworkMessage*& slot = window[messages % kInFlight];
+                if (mode.batch && messages % kInFlight == 0) {
+                    if (slot) {
+                        if (mode.memsetFirst) {
+                            for (NetworkMessage* msg : window) std::memset(msg->data, 0, sizeof(msg->data));
+                        }
+                        pool.releaseBatch(window, kInFlight);
+                    }
+                    pool.borrowBatch(window, kInFlight);
+                } else if (!mode.batch) {
+                    if (slot) {
+                        if (mode.memsetFirst) std::memset(slot->data, 0, sizeof(slot->data));
+                        pool.release(slot);
+                    }
+                    slot = pool.borrow();
+                }
+                slot->data[0] = static_cast<char>(messages);
+                uint64_t lookup = CycleClock::now();
+                for (size_t k = 0; k < 32; ++k) sum += table[(messages * 33 + k * 127) & (table.size() - 1)];
+                tableTicks += CycleClock::now() - lookup;
+            }
+        }
+        int64_t l1Misses = l1.stop();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        for (NetworkMessage* msg : window) pool.release(msg);
+        decodeSink = sum;
+        std::string misses = l1Misses < 0 ? std::string("-")
+                                          : std::to_string(static_cast<double>(l1Misses) / messages).substr(0, 6);
+        std::printf("%-11s %12.0f %10.1f %12.1f %12s\n", mode.name, static_cast<double>(messages) / seconds,
+                    seconds * 1e9 / static_cast<double>(messages),
+                    static_cast<double>(CycleClock::toNanos(tableTicks)) / static_cast<double>(messages),
+                    misses.c_str());
+    }
+}
+
+struct Benchmark {
+    const char* name;
+    std::function<void(const BenchOptions&)> run;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::vector<Benchmark> benchmarks = {
+        {"fairness", runFairness},
+        {"locking", runLocking},
+        {"reuse", runReuse},
+        {"prefetch", runPrefetch},
+        {"scrub", runScrub},
+    };
+
+    BenchOptions options;
+    std::vector<std::string> selected;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--capacity") == 0 && i + 1 < argc) {
+            options.capacity = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            options.seconds = std::atof(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            return 2;
+        } else {
+            selected.push_back(argv[i]);
+        }
+    }
+
+    for (const std::string& name : selected) {
+        auto it = std::find_if(benchmarks.begin(), benchmarks.end(),
+                               [&](const Benchmark& b) { return name == b.name; });
+        if (it == benchmarks.end()) {
+            std::cerr << "Unknown benchmark: " << name << "\n";
+            return 2;
+        }
+    }
+
+    for (const Benchmark& benchmark : benchmarks) {
+        if (selected.empty() || std::find(selected.begin(), selected.end(), benchmark.name) != selected.end()) {
+            benchmark.run(options);
+        }
+    }
+    return 0;
+}
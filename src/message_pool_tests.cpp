@@ -1,8 +1,15 @@
 #include "message_pool.h"
 #include <gtest/gtest.h>
 #include <thread>
+#include <atomic>
+#include <string>
+#include <mutex>
+#include <condition_variable>
 #include <vector>
 #include <random>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
 
 using namespace std::chrono_literals;
 
@@ -78,9 +85,94 @@ TEST(MessagePoolTest, MessageReuse) {
     }
 }
 
+TEST(MessagePoolTest, LifoReuseReturnsMostRecentSlot) {
+    MessagePool pool(4);
+    EXPECT_EQ(pool.reuseOrder(), ReuseOrder::Fifo);
+    pool.setReuseOrder(ReuseOrder::Lifo);
+
+    auto* a = pool.borrow();
+    auto* b = pool.borrow();
+    pool.release(a);
+    pool.release(b);
+    EXPECT_EQ(pool.borrow(), b);
+    EXPECT_EQ(pool.borrow(), a);
+
+    NetworkMessage* batch[3];
+    pool.release(a);
+    ASSERT_EQ(pool.borrowBatch(batch, 3), 3u);
+    EXPECT_EQ(batch[0], a); // Most recent first, then the never-used slots
+    EXPECT_EQ(pool.available(), 0u);
+
+    pool.setReuseOrder(ReuseOrder::Fifo);
+    pool.release(batch[1]);
+    pool.release(b);
+    EXPECT_EQ(pool.borrow(), batch[1]);
+}
+
+TEST(MessagePoolTest, PrefetchDoesNotChangeBorrowOrder) {
+    for (Prefetch mode : {Prefetch::Off, Prefetch::Next, Prefetch::Batch}) {
+        for (ReuseOrder order : {ReuseOrder::Fifo, ReuseOrder::Lifo}) {
+            MessagePool pool(8);
+            pool.setPrefetch(mode);
+            pool.setReuseOrder(order);
+            EXPECT_EQ(pool.prefetch(), mode);
+
+            NetworkMessage* batch[8];
+            ASSERT_EQ(pool.borrowBatch(batch, 8), 8u);
+            pool.releaseBatch(batch, 8);
+            auto* single = pool.borrow();
+            EXPECT_EQ(single, order == ReuseOrder::Fifo ? batch[0] : batch[7]);
+            ASSERT_EQ(pool.borrowBatch(batch, 8), 7u); // Drains the list, nothing left to prefetch
+            pool.release(single);
+            pool.releaseBatch(batch, 7);
+            EXPECT_EQ(pool.available(), 8u);
+        }
+    }
+}
+
+TEST(MessagePoolTest, ScrubbingZeroesPayload) {
+    const char zeros[sizeof(NetworkMessage::data)] = {};
+    for (Scrub mode : {Scrub::OnRelease, Scrub::OnBorrow, Scrub::Background}) {
+        MessagePool pool(1, 1s);
+        pool.setScrub(mode);
+        EXPECT_EQ(pool.scrub(), mode);
+
+        auto* msg = pool.borrow();
+        std::memset(msg->data, 'x', sizeof(msg->data));
+        msg->length = 1; // Bytes past length are scrubbed too
+        pool.release(msg);
+        EXPECT_EQ(pool.available(), 1u);
+
+        msg = pool.borrow(); // Background: waits for the scrubber to free it
+        EXPECT_EQ(std::memcmp(msg->data, zeros, sizeof(zeros)), 0);
+        EXPECT_EQ(msg->id, 0); // Scrubbing keeps the header
+        std::memset(msg->data, 'y', sizeof(msg->data));
+        NetworkMessage* batch[1] = {msg};
+        pool.releaseBatch(batch, 1);
+        ASSERT_EQ(pool.borrowBatch(batch, 1), 1u);
+        EXPECT_EQ(std::memcmp(batch[0]->data, zeros, sizeof(zeros)), 0);
+        pool.release(batch[0]); // Background: left for the scrubber at destruction
+    }
+
+    // Whole-line scrubbing stays inside the slot
+    MessagePool pool(2, 1s);
+    pool.setScrub(Scrub::OnRelease);
+    auto* scrubbed = pool.borrow();
+    auto* neighbour = pool.borrow();
+    std::memset(neighbour->data, 'n', sizeof(neighbour->data));
+    neighbour->length = 7;
+    pool.release(scrubbed);
+    EXPECT_EQ(neighbour->length, 7);
+    EXPECT_EQ(std::string(neighbour->data, sizeof(neighbour->data)), std::string(sizeof(neighbour->data), 'n'));
+    pool.release(neighbour);
+
+    BasicMessagePool<NoLock> confined(1);
+    EXPECT_THROW(confined.setScrub(Scrub::Background), std::runtime_error);
+}
+
 TEST(MessagePoolTest, InvalidRelease) {
     MessagePool pool(2);
-    NetworkMessage invalidMsg;
+    NetworkMessage invalidMsg{};
     invalidMsg.id = -1;
 
     EXPECT_THROW(pool.release(&invalidMsg), std::runtime_error);
@@ -88,8 +180,757 @@ TEST(MessagePoolTest, InvalidRelease) {
     invalidMsg.id = 2; // Out of bounds
     EXPECT_THROW(pool.release(&invalidMsg), std::runtime_error);
 
-    invalidMsg.id = 0;
-    EXPECT_NO_THROW(pool.release(&invalidMsg)); // Actually in pool
+    invalidMsg.id = 0; // Plausible id, but not a pool slot
+    EXPECT_THROW(pool.release(&invalidMsg), std::runtime_error);
+    NetworkMessage* batch[1] = {&invalidMsg};
+    EXPECT_THROW(pool.releaseBatch(batch, 1), std::runtime_error);
+    EXPECT_EQ(pool.available(), 2u);
+
+    auto* msg = pool.borrow();
+    auto* inside = reinterpret_cast<NetworkMessage*>(reinterpret_cast<char*>(msg) + 8);
+    EXPECT_THROW(pool.release(inside), std::runtime_error); // Not at a slot boundary
+
+    msg->length = sizeof(msg->data) + 1; // Claims more than the payload holds
+    EXPECT_THROW(pool.release(msg), std::runtime_error);
+
+    msg->length = 0;
+    msg->id = 1; // The pool goes by address, not the id field
+    EXPECT_NO_THROW(pool.release(msg));
+    EXPECT_THROW(pool.release(msg), std::runtime_error); // Already released
+    EXPECT_EQ(pool.available(), 2u);
+}
+
+TEST(MessagePoolTest, DoubleReleaseRejectedOnEveryPath) {
+    {
+        MessagePool pool(4, 100ms);
+        NetworkMessage* msgs[2];
+        ASSERT_EQ(pool.borrowBatch(msgs, 2), 2u);
+        NetworkMessage* dup[3] = {msgs[0], msgs[1], msgs[0]};
+        EXPECT_THROW(pool.releaseBatch(dup, 3), std::runtime_error);
+        EXPECT_EQ(pool.available(), 2u); // Rejected as a whole
+        pool.releaseBatch(msgs, 2);
+        EXPECT_EQ(pool.available(), 4u);
+    }
+    {
+        MessagePool pool(4, 100ms);
+        pool.setRemoteFree(true);
+        auto* msg = pool.borrow();
+        std::thread([&]() {
+            pool.release(msg);
+            EXPECT_THROW(pool.release(msg), std::runtime_error); // Still parked on the owner's list
+        }).join();
+        EXPECT_EQ(pool.available(), 4u);
+        NetworkMessage* all[4];
+        ASSERT_EQ(pool.borrowBatch(all, 4), 4u);
+        pool.releaseBatch(all, 4);
+        EXPECT_EQ(pool.available(), 4u);
+    }
+    {
+        MessagePool pool(4, 100ms);
+        pool.setScrub(Scrub::Background);
+        auto* msg = pool.borrow();
+        pool.release(msg);
+        EXPECT_THROW(pool.release(msg), std::runtime_error); // Queued for the scrubber
+        EXPECT_EQ(pool.available(), 4u);
+    }
+}
+
+#if MESSAGE_POOL_CHECKED && !defined(MESSAGE_POOL_ASAN)
+TEST(MessagePoolTest, CheckedModeCatchesOverrunAndUseAfterRelease) {
+    MessagePool pool(2);
+    EXPECT_GT(MessagePool::slotStride(), sizeof(NetworkMessage));
+    EXPECT_EQ(pool.slotAt(1), reinterpret_cast<NetworkMessage*>(
+        reinterpret_cast<char*>(pool.slab()) + MessagePool::slotStride()));
+
+    auto* msg = pool.borrow();
+    char* pastEnd = msg->data + sizeof(msg->data);
+    pastEnd[3] = 'x'; // Lands in the guard zone, not the next slot's id
+    EXPECT_EQ(pool.slotAt(1)->id, 1);
+    try {
+        pool.release(msg);
+        FAIL() << "overrun not detected";
+    } catch (const std::runtime_error& e) {
+        EXPECT_STREQ(e.what(), "Message overran its slot");
+    }
+
+    auto* stale = pool.borrow();
+    pool.release(stale);
+    stale->data[100] = 'y'; // Written after release
+    try {
+        pool.borrow();
+        FAIL() << "write after release not detected";
+    } catch (const std::runtime_error& e) {
+        EXPECT_STREQ(e.what(), "Message written after release");
+    }
+
+    // Mid-batch: the corrupt slot is dropped, the rest go back
+    MessagePool batchPool(4);
+    auto* first = batchPool.borrow();
+    batchPool.release(first);
+    first->data[0] = 'z';
+    NetworkMessage* out[4];
+    EXPECT_THROW(batchPool.borrowBatch(out, 4), std::runtime_error);
+    EXPECT_EQ(batchPool.available(), 3u);
+    EXPECT_EQ(batchPool.borrowBatch(out, 4), 3u);
+    batchPool.releaseBatch(out, 3);
+}
+#endif
+
+TEST(MessagePoolTest, MessageHeader) {
+    MessagePool pool(1);
+
+    auto* msg = pool.borrow();
+    std::strcpy(msg->data, "heartbeat");
+    msg->length = 9;
+    msg->type = 7;
+    msg->sequence = 42;
+    msg->timestamp = 1000;
+
+    NetworkMessage copy{};
+    copyMessage(&copy, msg);
+    EXPECT_EQ(copy.length, 9);
+    EXPECT_EQ(copy.type, 7);
+    EXPECT_EQ(copy.sequence, 42u);
+    EXPECT_EQ(copy.timestamp, 1000u);
+    EXPECT_EQ(std::string(copy.data, copy.length), "heartbeat");
+    EXPECT_EQ(copy.data[copy.length], '\0'); // Nothing past the live bytes was copied
+
+    // A corrupt length is rejected rather than overrunning the copy
+    msg->length = sizeof(msg->data) + 1;
+    NetworkMessage untouched{};
+    EXPECT_THROW(copyMessage(&untouched, msg), std::runtime_error);
+    EXPECT_EQ(untouched.length, 0);
+    msg->length = 9;
+
+    // A reborrowed message starts with a clean header
+    pool.release(msg);
+    msg = pool.borrow();
+    EXPECT_EQ(msg->length, 0);
+    EXPECT_EQ(msg->type, 0);
+    EXPECT_EQ(msg->sequence, 0u);
+    EXPECT_EQ(msg->timestamp, 0u);
+    pool.release(msg);
+}
+
+TEST(MessagePoolTest, BatchBorrowRelease) {
+    MessagePool pool(4);
+    NetworkMessage* batch[8];
+
+    // Takes what is free, up to the requested count
+    EXPECT_EQ(pool.borrowBatch(batch, 3), 3);
+    EXPECT_EQ(pool.available(), 1);
+    EXPECT_EQ(pool.borrowBatch(batch + 3, 5), 1);
+    EXPECT_EQ(pool.available(), 0);
+    EXPECT_THROW(pool.borrowBatch(batch, 1), std::runtime_error);
+
+    pool.releaseBatch(batch, 4);
+    EXPECT_EQ(pool.available(), 4);
+}
+
+TEST(MessagePoolTest, Statistics) {
+    MessagePool pool(3, 10ms);
+    NetworkMessage* msgs[3];
+
+    msgs[0] = pool.borrow();
+    EXPECT_EQ(pool.borrowBatch(msgs + 1, 2), 2);
+    EXPECT_THROW(pool.borrow(), std::runtime_error);
+    pool.release(msgs[0]);
+    pool.releaseBatch(msgs + 1, 2);
+
+    auto stats = pool.stats();
+    EXPECT_EQ(stats.borrows, 3u);
+    EXPECT_EQ(stats.releases, 3u);
+    EXPECT_EQ(stats.waits, 1u);
+    EXPECT_EQ(stats.timeouts, 1u);
+    EXPECT_GE(stats.waitTimeNs, 10000000u);
+    EXPECT_EQ(stats.lowWaterFree, 0u);
+    EXPECT_EQ(stats.highWaterInUse, 3u);
+}
+
+TEST(MessagePoolTest, LatencyHistograms) {
+    MessagePool pool(1, 20ms);
+
+    auto* msg = pool.borrow();
+    std::thread releaser([&]() {
+        std::this_thread::sleep_for(5ms);
+        pool.release(msg);
+    });
+    auto* next = pool.borrow(); // Blocks until the releaser hands msg back
+    releaser.join();
+    pool.release(next);
+
+    auto waits = pool.waitHistogram();
+    EXPECT_EQ(waits.count(), 1u);
+    EXPECT_GE(waits.percentile(0.5), 1000000u); // Waited well over a millisecond
+
+    auto holds = pool.holdHistogram();
+    EXPECT_EQ(holds.count(), 2u);
+    EXPECT_GE(holds.percentile(1.0), 4000000u); // First hold spanned the 5ms sleep
+}
+
+TEST(MessagePoolTest, HistogramBuckets) {
+    EXPECT_EQ(LatencyHistogram::bucketFor(0), 0u);
+    EXPECT_EQ(LatencyHistogram::bucketFor(1), 1u);
+    EXPECT_EQ(LatencyHistogram::bucketFor(1023), 10u);
+    EXPECT_EQ(LatencyHistogram::bucketFor(1024), 11u);
+    EXPECT_EQ(LatencyHistogram::bucketFor(UINT64_MAX), HistogramSnapshot::kBuckets - 1);
+
+    LatencyHistogram hist;
+    for (int i = 0; i < 99; ++i) hist.record(100);
+    hist.record(100000);
+    auto snap = hist.snapshot();
+    EXPECT_EQ(snap.count(), 100u);
+    EXPECT_EQ(snap.percentile(0.5), 127u);
+    EXPECT_EQ(snap.percentile(0.999), 131071u);
+}
+
+TEST(MessagePoolTest, HeldLongerThan) {
+    MessagePool pool(3);
+
+    auto* old = pool.borrow(); int oldLine = __LINE__;
+    std::this_thread::sleep_for(20ms);
+    auto* fresh = pool.borrow();
+
+    auto held = pool.heldLongerThan(10ms);
+    ASSERT_EQ(held.size(), 1u);
+    EXPECT_EQ(held[0].msg, old);
+    EXPECT_EQ(held[0].index, static_cast<size_t>(old->id));
+    EXPECT_GE(held[0].heldFor, 20ms);
+    EXPECT_EQ(held[0].ownerThread, static_cast<uint64_t>(::gettid()));
+#if MESSAGE_POOL_TRACK_CALLSITES
+    EXPECT_STREQ(held[0].site.file, __FILE__);
+    EXPECT_EQ(held[0].site.line, oldLine);
+#endif
+    (void)oldLine;
+
+    EXPECT_EQ(pool.heldLongerThan(0ns).size(), 2u);
+
+    pool.release(old);
+    pool.release(fresh);
+    EXPECT_TRUE(pool.heldLongerThan(0ns).empty());
+}
+
+TEST(MessagePoolTest, PoolIdsAreUnique) {
+    MessagePool a(1);
+    MessagePool b(1);
+    EXPECT_NE(a.id(), b.id());
+}
+
+TEST(MessagePoolTest, PersistentPoolRecoversInFlight) {
+    std::string path = ::testing::TempDir() + "message_pool_" + std::to_string(::getpid()) + ".bin";
+    ::unlink(path.c_str());
+
+    {
+        MessagePool pool(path, 4);
+        EXPECT_TRUE(pool.recovered().empty());
+
+        auto* msg1 = pool.borrow();
+        auto* msg2 = pool.borrow();
+        std::strcpy(msg1->data, "order-ack");
+        std::strcpy(msg2->data, "fill");
+        pool.release(msg1);
+        EXPECT_THROW(MessagePool(path, 4), std::runtime_error); // Locked while in use
+        // Pool goes away with msg2 still in flight, as after a crash
+    }
+
+    {
+        MessagePool pool(path, 4);
+        EXPECT_EQ(pool.available(), 3);
+        ASSERT_EQ(pool.recovered().size(), 1);
+
+        auto* msg = pool.recovered().front();
+        EXPECT_STREQ(msg->data, "fill");
+        pool.release(msg);
+        EXPECT_EQ(pool.available(), 4);
+    }
+
+    // Process died mid-release, with the slot still queued for its scrubber:
+    // left borrowed here, then marked releasing in the file by hand
+    size_t index;
+    {
+        MessagePool pool(path, 4);
+        auto* msg = pool.borrow();
+        std::strcpy(msg->data, "secret");
+        index = static_cast<size_t>(msg->id);
+    }
+    uint8_t releasing = 2;
+    off_t stateOffset = static_cast<off_t>((sizeof(PoolFileHeader) + 63) / 64 * 64 + index);
+    int fd = ::open(path.c_str(), O_RDWR);
+    ASSERT_EQ(::pwrite(fd, &releasing, 1, stateOffset), 1);
+    ::close(fd);
+    {
+        MessagePool pool(path, 4);
+        EXPECT_TRUE(pool.recovered().empty());
+        NetworkMessage* msgs[4];
+        ASSERT_EQ(pool.borrowBatch(msgs, 4), 4u);
+        for (auto* msg : msgs) EXPECT_NE(std::strncmp(msg->data, "secret", 6), 0);
+        pool.releaseBatch(msgs, 4);
+    }
+
+    // Capacity must match the file it was created with
+    EXPECT_THROW(MessagePool(path, 8), std::runtime_error);
+
+    // Creator died after sizing the file but before writing the header
+    struct stat st;
+    ASSERT_EQ(::stat(path.c_str(), &st), 0);
+    ASSERT_EQ(::truncate(path.c_str(), 0), 0);
+    ASSERT_EQ(::truncate(path.c_str(), st.st_size), 0);
+    {
+        MessagePool pool(path, 4);
+        EXPECT_TRUE(pool.recovered().empty());
+        EXPECT_EQ(pool.available(), 4u);
+    }
+    ::unlink(path.c_str());
+}
+
+TEST(MessagePoolTest, WatermarksAreEdgeTriggered) {
+    MessagePool pool(10, 1ms);
+    std::vector<std::pair<Watermark, size_t>> events;
+    pool.setWatermarks(2, 5, [&](Watermark mark, size_t free) { events.emplace_back(mark, free); });
+    EXPECT_FALSE(pool.underPressure());
+
+    std::vector<NetworkMessage*> held;
+    for (int i = 0; i < 9; ++i) held.push_back(pool.borrow());
+    ASSERT_EQ(events.size(), 1u); // Only the crossing fires, not every borrow below it
+    EXPECT_EQ(events[0].first, Watermark::Low);
+    EXPECT_EQ(events[0].second, 2u);
+    EXPECT_TRUE(pool.underPressure());
+
+    // Recovering past low but short of high keeps the pressure on
+    for (int i = 0; i < 3; ++i) {
+        pool.release(held.back());
+        held.pop_back();
+    }
+    EXPECT_EQ(events.size(), 1u);
+
+    pool.release(held.back());
+    held.pop_back();
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(events[1].first, Watermark::High);
+    EXPECT_EQ(events[1].second, 5u);
+    EXPECT_FALSE(pool.underPressure());
+
+    // Each crossing made the eventfd readable once
+    uint64_t crossings = 0;
+    ASSERT_EQ(::read(pool.watermarkFd(), &crossings, sizeof(crossings)), static_cast<ssize_t>(sizeof(crossings)));
+    EXPECT_EQ(crossings, 2u);
+    EXPECT_EQ(::read(pool.watermarkFd(), &crossings, sizeof(crossings)), -1); // Drained
+
+    pool.releaseBatch(held.data(), held.size());
+    EXPECT_THROW(pool.setWatermarks(5, 5), std::runtime_error);
+    EXPECT_THROW(pool.setWatermarks(2, 11), std::runtime_error);
+}
+
+TEST(MessagePoolTest, WatermarkFiresWhenAlreadyLow) {
+    MessagePool pool(4, 1ms);
+    EXPECT_EQ(pool.watermarkFd(), -1);
+    NetworkMessage* msgs[4];
+    ASSERT_EQ(pool.borrowBatch(msgs, 4), 4u);
+
+    int lows = 0;
+    pool.setWatermarks(1, 3, [&](Watermark mark, size_t) { lows += mark == Watermark::Low; });
+    EXPECT_EQ(lows, 1);
+    EXPECT_TRUE(pool.underPressure());
+    pool.releaseBatch(msgs, 4);
+    EXPECT_FALSE(pool.underPressure());
+}
+
+TEST(MessagePoolTest, ReservedSlotsForHighPriority) {
+    MessagePool pool(4, 1ms);
+    pool.reserveForHighPriority(1);
+    EXPECT_EQ(pool.reservedForHighPriority(), 1u);
+    EXPECT_THROW(pool.reserveForHighPriority(5), std::runtime_error);
+
+    NetworkMessage* msgs[4];
+    EXPECT_EQ(pool.borrowBatch(msgs, 4, Priority::Low), 3u); // Batch stops at the reserve
+    EXPECT_THROW(pool.borrow(), std::runtime_error);
+    msgs[3] = pool.borrow(Priority::High);
+    EXPECT_NE(msgs[3], nullptr);
+    EXPECT_THROW(pool.borrow(Priority::High), std::runtime_error);
+
+    PriorityStats low = pool.priorityStats(Priority::Low);
+    PriorityStats normal = pool.priorityStats(Priority::Normal);
+    PriorityStats high = pool.priorityStats(Priority::High);
+    EXPECT_EQ(low.borrows, 3u);
+    EXPECT_EQ(normal.borrows, 0u);
+    EXPECT_EQ(normal.timeouts, 1u);
+    EXPECT_EQ(high.borrows, 1u);
+    EXPECT_EQ(high.waits, 1u);
+    EXPECT_EQ(high.timeouts, 1u);
+
+    pool.releaseBatch(msgs, 4);
+    pool.reserveForHighPriority(0);
+    EXPECT_EQ(pool.borrowBatch(msgs, 4), 4u);
+    pool.releaseBatch(msgs, 4);
+}
+
+TEST(MessagePoolTest, WaitersWokenInPriorityOrder) {
+    MessagePool pool(1, 5s);
+    auto* held = pool.borrow();
+
+    std::mutex mutex;
+    std::vector<Priority> order;
+    std::vector<std::thread> waiters;
+    // Queue up lowest first so arrival order can't explain the result
+    for (Priority priority : {Priority::Low, Priority::Normal, Priority::High}) {
+        waiters.emplace_back([&, priority]() {
+            auto* msg = pool.borrow(priority);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back(priority);
+            }
+            pool.release(msg);
+        });
+        // Counted under the pool lock, so the waiter is asleep by the time release() gets it
+        while (pool.priorityStats(priority).waits == 0) std::this_thread::yield();
+    }
+
+    pool.release(held);
+    for (auto& t : waiters) t.join();
+    EXPECT_EQ(order, (std::vector<Priority>{Priority::High, Priority::Normal, Priority::Low}));
+}
+
+TEST(MessagePoolTest, FairModeHandsOffInArrivalOrder) {
+    MessagePool pool(1, 5s);
+    pool.setFairWaiting(true);
+    auto* held = pool.borrow();
+
+    std::mutex mutex;
+    std::vector<int> order;
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < 4; ++i) {
+        waiters.emplace_back([&, i]() {
+            auto* msg = pool.borrow();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back(i);
+            }
+            pool.release(msg);
+        });
+        // Queued under the same lock hold that counts the wait
+        while (pool.priorityStats(Priority::Normal).waits < static_cast<uint64_t>(i + 1)) std::this_thread::yield();
+    }
+
+    pool.release(held);
+    EXPECT_EQ(pool.available(), 0u); // Handed to the first waiter, not left for barging
+    for (auto& t : waiters) t.join();
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 2, 3}));
+    EXPECT_EQ(pool.available(), 1u);
+}
+
+TEST(MessagePoolTest, FairModeTimeoutLeavesQueue) {
+    MessagePool pool(2, 1ms);
+    pool.setFairWaiting(true);
+    EXPECT_TRUE(pool.fairWaiting());
+    NetworkMessage* msgs[2];
+    ASSERT_EQ(pool.borrowBatch(msgs, 2), 2u);
+
+    EXPECT_THROW(pool.borrow(), std::runtime_error);
+    pool.release(msgs[0]);
+    EXPECT_EQ(pool.available(), 1u); // Nobody left queued to hand it to
+
+    // High waiters are served from the reserve ahead of queued Normal ones
+    pool.reserveForHighPriority(1);
+    EXPECT_THROW(pool.borrow(), std::runtime_error);
+    msgs[0] = pool.borrow(Priority::High);
+    pool.releaseBatch(msgs, 2);
+    EXPECT_EQ(pool.available(), 2u);
+}
+
+TEST(MessagePoolTest, AvailableFdTracksFreeSlots) {
+    MessagePool pool(2, 1ms);
+    int fd = pool.availableFd();
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(pool.availableFd(), fd);
+
+    auto readable = [fd]() {
+        pollfd p{fd, POLLIN, 0};
+        return ::poll(&p, 1, 0) == 1;
+    };
+    EXPECT_TRUE(readable());
+
+    NetworkMessage* msgs[2];
+    ASSERT_EQ(pool.borrowBatch(msgs, 2), 2u);
+    EXPECT_FALSE(readable());
+    pool.release(msgs[0]);
+    EXPECT_TRUE(readable());
+    msgs[0] = pool.borrow();
+    EXPECT_FALSE(readable());
+
+    pool.releaseBatch(msgs, 2);
+    EXPECT_TRUE(readable());
+}
+
+TEST(MessagePoolTest, AvailableFdIgnoresReservedSlots) {
+    MessagePool pool(4, 1ms);
+    pool.reserveForHighPriority(2);
+    int fd = pool.availableFd();
+    auto readable = [fd]() {
+        pollfd p{fd, POLLIN, 0};
+        return ::poll(&p, 1, 0) == 1;
+    };
+    EXPECT_TRUE(readable());
+
+    // Only reserved slots left: a woken epoll loop's tryBorrow() would fail
+    NetworkMessage* msgs[2];
+    ASSERT_EQ(pool.borrowBatch(msgs, 2), 2u);
+    EXPECT_FALSE(readable());
+    EXPECT_EQ(pool.tryBorrow(), nullptr);
+    auto* urgent = pool.borrow(Priority::High);
+    EXPECT_FALSE(readable());
+
+    pool.release(urgent);
+    EXPECT_FALSE(readable());
+    pool.release(msgs[0]);
+    EXPECT_TRUE(readable());
+
+    // Shrinking the reserve frees slots for Normal borrowers
+    msgs[0] = pool.borrow();
+    EXPECT_FALSE(readable());
+    pool.reserveForHighPriority(1);
+    EXPECT_TRUE(readable());
+    pool.releaseBatch(msgs, 2);
+}
+
+TEST(MessagePoolTest, StopTokenCallbacks) {
+    StopSource source;
+    StopToken token = source.token();
+    int calls = 0;
+    {
+        StopCallback dropped(token, [&]() { calls += 100; });
+    }
+    StopCallback registered(token, [&]() { ++calls; });
+    EXPECT_FALSE(token.stopRequested());
+    EXPECT_TRUE(source.requestStop());
+    EXPECT_FALSE(source.requestStop());
+    EXPECT_TRUE(token.stopRequested());
+    EXPECT_EQ(calls, 1);
+
+    StopCallback late(token, [&]() { ++calls; }); // Runs at once
+    EXPECT_EQ(calls, 2);
+    EXPECT_FALSE(StopToken().stopPossible());
+}
+
+TEST(MessagePoolTest, StopTokenCancelsBlockedBorrow) {
+    MessagePool pool(1, 5s);
+    StopSource source;
+    auto* held = pool.borrow(source.token()); // A free slot is taken as usual
+
+    std::string error;
+    auto start = std::chrono::steady_clock::now();
+    std::thread waiter([&]() {
+        try {
+            pool.borrow(source.token());
+        } catch (const std::runtime_error& e) {
+            error = e.what();
+        }
+    });
+    while (pool.priorityStats(Priority::Normal).waits == 0) std::this_thread::yield();
+    source.requestStop();
+    waiter.join();
+
+    EXPECT_EQ(error, "Borrow cancelled");
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+    EXPECT_EQ(pool.stats().timeouts, 0u);
+    EXPECT_THROW(pool.borrow(source.token()), std::runtime_error); // Already stopped: no wait
+    pool.release(held);
+    EXPECT_NE(pool.borrow(source.token()), nullptr);
+}
+
+TEST(MessagePoolTest, ShutdownWakesAllWaiters) {
+    for (bool fair : {false, true}) {
+        MessagePool pool(1, 5s);
+        pool.setFairWaiting(fair);
+        auto* held = pool.borrow();
+
+        std::atomic<int> shutDown{0};
+        std::vector<std::thread> waiters;
+        for (Priority priority : {Priority::Low, Priority::Normal, Priority::High}) {
+            waiters.emplace_back([&, priority]() {
+                try {
+                    pool.borrow(priority);
+                } catch (const std::runtime_error& e) {
+                    if (std::string(e.what()) == "Message pool is shut down") ++shutDown;
+                }
+            });
+        }
+        for (Priority priority : {Priority::Low, Priority::Normal, Priority::High}) {
+            while (pool.priorityStats(priority).waits == 0) std::this_thread::yield();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        pool.shutdown();
+        for (auto& t : waiters) t.join();
+        EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+        EXPECT_EQ(shutDown.load(), 3);
+        EXPECT_TRUE(pool.isShutdown());
+
+        // New borrows are refused; outstanding messages still drain
+        EXPECT_THROW(pool.borrow(), std::runtime_error);
+        EXPECT_EQ(pool.tryBorrow(), nullptr);
+        pool.release(held);
+        EXPECT_EQ(pool.available(), 1u);
+        NetworkMessage* msgs[1];
+        EXPECT_THROW(pool.borrowBatch(msgs, 1), std::runtime_error);
+    }
+}
+
+TEST(MessagePoolTest, RemoteReleaseReclaimedOnOwnersBorrow) {
+    MessagePool pool(4, 1s);
+    pool.setRemoteFree(true);
+    pool.setReuseOrder(ReuseOrder::Lifo); // Next borrow shows whether `a` is back on the free list
+    auto* a = pool.borrow();
+    auto* b = pool.borrow();
+
+    std::thread([&]() { pool.release(a); }).join();
+    EXPECT_EQ(pool.available(), 3u);
+    EXPECT_EQ(pool.stats().releases, 1u);
+    EXPECT_EQ(pool.heldLongerThan(0ns).size(), 1u); // Released, though parked on the owner's list
+
+    EXPECT_EQ(pool.borrow(), a); // Reclaimed without waiting
+    EXPECT_EQ(pool.stats().waits, 0u);
+    pool.release(a); // Owner's own releases take the locked path
+    pool.release(b);
+    EXPECT_EQ(pool.available(), 4u);
+    EXPECT_TRUE(pool.heldLongerThan(0ns).empty());
+
+    pool.setRemoteFree(false);
+    EXPECT_FALSE(pool.remoteFree());
+}
+
+TEST(MessagePoolTest, RemoteReleaseDoesNotStrandSlots) {
+    {
+        // Owner drains the pool and goes quiet; a worker releases everything
+        MessagePool pool(4, 1s);
+        pool.setRemoteFree(true);
+        int fd = pool.availableFd();
+        NetworkMessage* msgs[4];
+        std::thread([&]() { ASSERT_EQ(pool.borrowBatch(msgs, 4), 4u); }).join();
+        std::thread([&]() { for (auto* msg : msgs) pool.release(msg); }).join();
+
+        EXPECT_EQ(pool.available(), 4u);
+        pollfd pfd{fd, POLLIN, 0};
+        EXPECT_EQ(::poll(&pfd, 1, 0), 1);
+        auto* msg = pool.tryBorrow();
+        EXPECT_NE(msg, nullptr);
+        pool.release(msg);
+    }
+    {
+        // Watermarks recover although the owner never borrows again
+        MessagePool pool(8, 1s);
+        pool.setRemoteFree(true);
+        pool.setWatermarks(2, 6);
+        NetworkMessage* msgs[6];
+        std::thread([&]() { ASSERT_EQ(pool.borrowBatch(msgs, 6), 6u); }).join();
+        EXPECT_TRUE(pool.underPressure());
+        std::thread([&]() { for (auto* msg : msgs) pool.release(msg); }).join();
+        EXPECT_FALSE(pool.underPressure());
+    }
+}
+
+TEST(MessagePoolTest, ParkedSlotsCountTowardWatermarks) {
+    MessagePool pool(100, 1s);
+    pool.setRemoteFree(true);
+    std::vector<std::pair<Watermark, size_t>> events;
+    pool.setWatermarks(10, 20, [&](Watermark mark, size_t free) { events.emplace_back(mark, free); });
+    int fd = pool.availableFd();
+
+    // The owner drains the pool; a worker releases everything. Once the
+    // pressure lifts, the rest of the releases park on the owner's list.
+    std::vector<NetworkMessage*> held(90);
+    ASSERT_EQ(pool.borrowBatch(held.data(), held.size()), 90u);
+    std::thread([&]() { for (auto* msg : held) pool.release(msg); }).join();
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(events[1].first, Watermark::High);
+    EXPECT_EQ(pool.available(), 100u);
+
+    // Another thread drains the free list, not the pool: no false pair of
+    // crossings, and the pool stays readable
+    events.clear();
+    std::vector<NetworkMessage*> other;
+    std::thread([&]() {
+        while (other.size() < 25) other.push_back(pool.tryBorrow());
+    }).join();
+    EXPECT_TRUE(events.empty());
+    EXPECT_FALSE(pool.underPressure());
+    EXPECT_EQ(pool.available(), 75u);
+    pollfd pfd{fd, POLLIN, 0};
+    EXPECT_EQ(::poll(&pfd, 1, 0), 1);
+    for (auto* msg : other) {
+        ASSERT_NE(msg, nullptr);
+        pool.release(msg);
+    }
+}
+
+TEST(MessagePoolTest, RemoteReleaseWakesBlockedOwner) {
+    for (bool fair : {false, true}) {
+        MessagePool pool(1, 5s);
+        pool.setFairWaiting(fair);
+        pool.setRemoteFree(true);
+        auto* held = pool.borrow();
+
+        std::thread releaser([&]() {
+            while (pool.priorityStats(Priority::Normal).waits == 0) std::this_thread::yield();
+            pool.release(held);
+        });
+        auto start = std::chrono::steady_clock::now();
+        EXPECT_EQ(pool.borrow(), held);
+        EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+        releaser.join();
+        pool.release(held);
+        EXPECT_EQ(pool.available(), 1u);
+    }
+}
+
+TEST(MessagePoolTest, RemoteFreeProducerConsumers) {
+    constexpr size_t kMessages = 20000;
+    MessagePool pool(16, 5s);
+    pool.setRemoteFree(true);
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<NetworkMessage*> queue;
+    bool done = false;
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < 3; ++w) {
+        workers.emplace_back([&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                ready.wait(lock, [&]() { return !queue.empty() || done; });
+                if (queue.empty()) return;
+                NetworkMessage* msg = queue.back();
+                queue.pop_back();
+                lock.unlock();
+                EXPECT_EQ(msg->length, 8u);
+                pool.release(msg);
+                lock.lock();
+            }
+        });
+    }
+
+    for (size_t i = 0; i < kMessages; ++i) {
+        NetworkMessage* msg = pool.borrow();
+        msg->length = 8;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(msg);
+        }
+        ready.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    ready.notify_all();
+    for (auto& t : workers) t.join();
+
+    EXPECT_EQ(pool.available(), 16u);
+    EXPECT_EQ(pool.stats().borrows, kMessages);
+    EXPECT_EQ(pool.stats().releases, kMessages);
+    EXPECT_EQ(pool.stats().timeouts, 0u);
+    pool.setRemoteFree(false); // Folds the parked slots back in
+    EXPECT_TRUE(pool.heldLongerThan(0ns).empty());
 }
 
 TEST(MessagePoolTest, ThreadSafety) {
@@ -154,6 +995,11 @@ TEST(MessagePoolTest, ThreadSafety) {
 
     EXPECT_GT(total_collisions, 0) << "No thread collisions detected - test not valid";
     EXPECT_EQ(pool.available(), POOL_SIZE) << "Pool leak detected";
+
+    auto stats = pool.stats();
+    EXPECT_EQ(stats.borrows, stats.releases);
+    EXPECT_EQ(stats.borrows + stats.timeouts, THREAD_COUNT * ITERATIONS);
+    EXPECT_EQ(stats.highWaterInUse, POOL_SIZE);
 }
 
 int main(int argc, char** argv) {
@@ -0,0 +1,97 @@
+// pool_planner: recommends a MessagePool capacity for a target probability
+// of borrow() having to wait, from a recorded trace or from live stats.
+//
+// Usage: pool_planner --trace <file> [--target P]
+//        pool_planner --stats <name> [--seconds S] [--target P]
+
+#include "capacity_planner.h"
+#include "stats_page.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+void printOption(const CapacityOption& option, const char* note) {
+    std::printf("%10zu %12.6f %14.1f  %s\n", option.capacity, option.waitProbability,
+                static_cast<double>(option.footprintBytes) / 1024.0, note);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string tracePath;
+    std::string statsName;
+    double target = 0.001;
+    long seconds = 10;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--trace") == 0) {
+            tracePath = argv[i + 1];
+        } else if (std::strcmp(argv[i], "--stats") == 0) {
+            statsName = argv[i + 1];
+        } else if (std::strcmp(argv[i], "--target") == 0) {
+            target = std::atof(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--seconds") == 0) {
+            seconds = std::atol(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            return 2;
+        }
+    }
+    if (tracePath.empty() == statsName.empty()) {
+        std::cerr << "Usage: " << argv[0] << " --trace <file> | --stats <name> [--seconds S] [--target P]\n";
+        return 2;
+    }
+
+    try {
+        CapacityPlanner planner;
+        if (!tracePath.empty()) {
+            Trace trace = Trace::load(tracePath);
+            planner = CapacityPlanner::fromTrace(trace);
+            std::printf("trace: %zu events, recorded capacity %llu, peak in use %zu\n",
+                        trace.events.size(), static_cast<unsigned long long>(trace.capacity), trace.peakInUse());
+            if (planner.saturated()) {
+                std::printf("warning: the recorded pool ran dry, so true demand is higher than observed;\n"
+                            "         re-record with a larger pool for an accurate answer\n");
+            }
+        } else {
+            StatsPageReader reader(statsName);
+            StatsSample before = reader.read();
+            std::this_thread::sleep_for(std::chrono::seconds(seconds));
+            StatsSample after = reader.read();
+
+            double elapsed = static_cast<double>(after.publishedNs - before.publishedNs) / 1e9;
+            if (elapsed <= 0) throw std::runtime_error("Stats page is not being updated");
+            HistogramSnapshot hold;
+            for (size_t i = 0; i < HistogramSnapshot::kBuckets; ++i) {
+                hold.buckets[i] = after.holdTime.buckets[i] - before.holdTime.buckets[i];
+            }
+
+            double rate = static_cast<double>(after.stats.borrows - before.stats.borrows) / elapsed;
+            double meanHold = CapacityPlanner::approximateMean(hold);
+            planner = CapacityPlanner::fromRates(rate, meanHold);
+            std::printf("stats: %.0f borrows/s, mean hold %.1f us, offered load %.2f messages\n",
+                        rate, meanHold / 1000.0, planner.offeredLoad());
+        }
+
+        CapacityOption best = planner.recommend(target);
+        std::printf("\n%10s %12s %14s\n", "capacity", "P(wait)", "footprint_KiB");
+        for (double t : {0.1, 0.01, 0.001, 0.0001}) {
+            if (t == target) continue;
+            CapacityOption option = planner.recommend(t);
+            char note[32];
+            std::snprintf(note, sizeof(note), "P(wait) <= %g", t);
+            printOption(option, note);
+        }
+        printOption(best, "<- recommended for target");
+        std::printf("\nrecommended capacity: %zu (P(wait) %.6f, %.1f KiB)\n", best.capacity,
+                    best.waitProbability, static_cast<double>(best.footprintBytes) / 1024.0);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+// pool_replay: drives a MessagePool through a trace recorded with EventRecorder
+// and reports throughput, borrow latency and peak usage.
+//
+// Usage: pool_replay <trace> [--capacity N] [--speed X] [--timeout-ms T]
+
+#include "message_pool.h"
+#include "trace_replay.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <trace> [--capacity N] [--speed X] [--timeout-ms T]\n";
+        return 2;
+    }
+
+    size_t capacity = 0;
+    long timeoutMs = 100;
+    ReplayOptions options;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--capacity") == 0) {
+            capacity = std::strtoul(argv[i + 1], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--speed") == 0) {
+            options.speed = std::atof(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--timeout-ms") == 0) {
+            timeoutMs = std::atol(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            return 2;
+        }
+    }
+
+    try {
+        Trace trace = Trace::load(argv[1]);
+        if (capacity == 0) capacity = trace.capacity;
+
+        MessagePool pool(capacity, std::chrono::milliseconds(timeoutMs));
+        ReplayResult result = replayTrace(pool, trace, options);
+
+        std::printf("events:          %zu (recorded capacity %llu, recorded peak %zu)\n",
+                    trace.events.size(), static_cast<unsigned long long>(trace.capacity), trace.peakInUse());
+        std::printf("capacity:        %zu\n", capacity);
+        std::printf("borrows:         %llu in %.3f s (%.0f/s)\n",
+                    static_cast<unsigned long long>(result.borrows), result.seconds, result.throughput());
+        std::printf("timeouts:        %llu\n", static_cast<unsigned long long>(result.timeouts));
+        std::printf("waits:           %llu\n", static_cast<unsigned long long>(result.waits));
+        std::printf("borrow p50/p99:  %.1f / %.1f us\n",
+                    result.borrowTime.percentile(0.50) / 1000.0, result.borrowTime.percentile(0.99) / 1000.0);
+        std::printf("peak in use:     %zu\n", result.peakInUse);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+// poolstat: vmstat-style monitor for a MessagePool published with StatsPublisher.
+//
+// Usage: poolstat <name> [interval_ms] [count]
+
+#include "stats_page.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+HistogramSnapshot delta(const HistogramSnapshot& now, const HistogramSnapshot& before) {
+    HistogramSnapshot d;
+    for (size_t i = 0; i < HistogramSnapshot::kBuckets; ++i) {
+        d.buckets[i] = now.buckets[i] - before.buckets[i];
+    }
+    return d;
+}
+
+double micros(uint64_t ns) { return static_cast<double>(ns) / 1000.0; }
+
+void printHeader() {
+    std::printf("%8s %8s %6s %10s %9s %9s %9s %9s %9s %9s %9s\n",
+                "capacity", "free", "util%", "borrow/s", "wait/s", "tmout/s",
+                "avgwt_us", "p50wt_us", "p99wt_us", "p50hd_us", "p99hd_us");
+}
+
+void printRow(const StatsSample& now, const StatsSample& before) {
+    double seconds = static_cast<double>(now.publishedNs - before.publishedNs) / 1e9;
+    if (seconds <= 0) seconds = 1;
+
+    uint64_t waits = now.stats.waits - before.stats.waits;
+    uint64_t waitNs = now.stats.waitTimeNs - before.stats.waitTimeNs;
+    HistogramSnapshot waitTime = delta(now.waitTime, before.waitTime);
+    HistogramSnapshot holdTime = delta(now.holdTime, before.holdTime);
+    double util = now.capacity ? 100.0 * static_cast<double>(now.capacity - now.available) /
+                                     static_cast<double>(now.capacity)
+                               : 0.0;
+
+    std::printf("%8llu %8llu %6.1f %10.0f %9.0f %9.0f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+                static_cast<unsigned long long>(now.capacity),
+                static_cast<unsigned long long>(now.available), util,
+                static_cast<double>(now.stats.borrows - before.stats.borrows) / seconds,
+                static_cast<double>(waits) / seconds,
+                static_cast<double>(now.stats.timeouts - before.stats.timeouts) / seconds,
+                waits ? micros(waitNs / waits) : 0.0,
+                micros(waitTime.percentile(0.50)), micros(waitTime.percentile(0.99)),
+                micros(holdTime.percentile(0.50)), micros(holdTime.percentile(0.99)));
+    std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <name> [interval_ms] [count]\n";
+        return 2;
+    }
+
+    long intervalMs = argc > 2 ? std::atol(argv[2]) : 1000;
+    long count = argc > 3 ? std::atol(argv[3]) : -1;
+    if (intervalMs <= 0) intervalMs = 1000;
+
+    try {
+        StatsPageReader reader(argv[1]);
+        StatsSample before = reader.read();
+
+        for (long i = 0; count < 0 || i < count; ++i) {
+            if (i % 20 == 0) printHeader();
+            std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+            StatsSample now = reader.read();
+            printRow(now, before);
+            before = now;
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
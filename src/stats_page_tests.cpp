@@ -0,0 +1,126 @@
+#include "stats_page.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+std::string pageName(const char* test) {
+    return std::string(test) + "." + std::to_string(::getpid());
+}
+
+// Maps a page writable behind the publisher's back, creating it if needed, the
+// way a publisher that has since died would have left it.
+StatsPage* mapPage(const std::string& name) {
+    int fd = ::shm_open(StatsPage::shmName(name).c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || ::ftruncate(fd, sizeof(StatsPage)) != 0) {
+        return nullptr;
+    }
+    void* addr = ::mmap(nullptr, sizeof(StatsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    return addr == MAP_FAILED ? nullptr : static_cast<StatsPage*>(addr);
+}
+
+} // namespace
+
+TEST(StatsPageTest, ReaderSeesPublishedStats) {
+    MessagePool pool(4, 1ms);
+    StatsPublisher publisher(pool, pageName("published"), 0ms); // Manual publishing only
+
+    auto* msg1 = pool.borrow();
+    auto* msg2 = pool.borrow();
+    pool.release(msg1);
+    publisher.publish();
+
+    StatsPageReader reader(pageName("published"));
+    StatsSample sample = reader.read();
+    EXPECT_EQ(sample.capacity, 4u);
+    EXPECT_EQ(sample.available, 3u);
+    EXPECT_EQ(sample.stats.borrows, 2u);
+    EXPECT_EQ(sample.stats.releases, 1u);
+    EXPECT_EQ(sample.stats.highWaterInUse, 2u);
+    EXPECT_EQ(sample.holdTime.count(), 1u);
+    EXPECT_GT(sample.publishedNs, 0u);
+
+    pool.release(msg2);
+}
+
+TEST(StatsPageTest, BackgroundPublisherUpdates) {
+    MessagePool pool(2);
+    StatsPublisher publisher(pool, pageName("background"), 5ms);
+    StatsPageReader reader(pageName("background"));
+
+    auto* msg = pool.borrow();
+    pool.release(msg);
+
+    StatsSample sample;
+    for (int i = 0; i < 200 && sample.stats.releases == 0; ++i) {
+        std::this_thread::sleep_for(5ms);
+        sample = reader.read();
+    }
+    EXPECT_EQ(sample.stats.borrows, 1u);
+    EXPECT_EQ(sample.stats.releases, 1u);
+}
+
+TEST(StatsPageTest, MissingPageThrows) {
+    EXPECT_THROW(StatsPageReader(pageName("missing")), std::runtime_error);
+}
+
+TEST(StatsPageTest, PageRemovedWithPublisher) {
+    MessagePool pool(1);
+    {
+        StatsPublisher publisher(pool, pageName("removed"), 0ms);
+        EXPECT_NO_THROW(StatsPageReader(pageName("removed")));
+    }
+    EXPECT_THROW(StatsPageReader(pageName("removed")), std::runtime_error);
+}
+
+TEST(StatsPageTest, SecondPublisherThrows) {
+    MessagePool pool(2);
+    MessagePool other(8);
+    StatsPublisher publisher(pool, pageName("owned"), 0ms);
+
+    EXPECT_THROW(StatsPublisher(other, pageName("owned"), 0ms), std::runtime_error);
+
+    StatsPageReader reader(pageName("owned"));
+    EXPECT_EQ(reader.read().capacity, 2u);
+}
+
+TEST(StatsPageTest, TakesOverPageOfDeadPublisher) {
+    StatsPage* page = mapPage(pageName("dead"));
+    ASSERT_NE(page, nullptr);
+    page->magic = StatsPage::kMagic;
+    page->version = StatsPage::kVersion;
+    page->sequence.store(7); // Died mid-write
+    page->capacity.store(99);
+
+    MessagePool pool(3);
+    StatsPublisher publisher(pool, pageName("dead"), 0ms);
+    StatsPageReader reader(pageName("dead"));
+    EXPECT_EQ(reader.read().capacity, 3u);
+    EXPECT_EQ(page->sequence.load() % 2, 0u);
+    ::munmap(page, sizeof(StatsPage));
+}
+
+TEST(StatsPageTest, ReaderReportsStalePage) {
+    MessagePool pool(1);
+    StatsPublisher publisher(pool, pageName("stale"), 0ms);
+    StatsPageReader reader(pageName("stale"));
+    StatsPage* page = mapPage(pageName("stale"));
+    ASSERT_NE(page, nullptr);
+
+    uint64_t seq = page->sequence.load();
+    page->sequence.store(seq + 1); // A write that never finishes
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_THROW(reader.read(), std::runtime_error);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 2s);
+
+    page->sequence.store(seq + 2);
+    EXPECT_NO_THROW(reader.read());
+    ::munmap(page, sizeof(StatsPage));
+}
@@ -0,0 +1,118 @@
+#include "udp_receiver.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+namespace {
+
+// Loopback UDP socket pair: rx is bound to an ephemeral port, tx sends to it.
+struct LoopbackPair {
+    int rx = -1;
+    int tx = -1;
+    sockaddr_in addr{};
+
+    LoopbackPair() {
+        rx = ::socket(AF_INET, SOCK_DGRAM, 0);
+        tx = ::socket(AF_INET, SOCK_DGRAM, 0);
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        ::bind(rx, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        socklen_t len = sizeof(addr);
+        ::getsockname(rx, reinterpret_cast<sockaddr*>(&addr), &len);
+    }
+
+    ~LoopbackPair() {
+        ::close(rx);
+        ::close(tx);
+    }
+
+    void send(const std::string& payload) {
+        ::sendto(tx, payload.data(), payload.size(), 0,
+                 reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    }
+};
+
+} // namespace
+
+TEST(UdpReceiverTest, ReceivesBatchIntoPool) {
+    MessagePool pool(16);
+    LoopbackPair sockets;
+    UdpReceiver receiver(pool, sockets.rx, 8);
+
+    std::vector<std::string> payloads = {"a", "bb", "ccc", std::string(256, 'x')};
+    for (const auto& p : payloads) sockets.send(p);
+
+    std::vector<NetworkMessage*> received;
+    size_t count = receiver.receive(received);
+
+    ASSERT_EQ(count, payloads.size());
+    ASSERT_EQ(received.size(), payloads.size());
+    for (size_t i = 0; i < count; ++i) {
+        EXPECT_EQ(received[i]->length, payloads[i].size());
+        EXPECT_EQ(std::string(received[i]->data, received[i]->length), payloads[i]);
+        EXPECT_EQ(received[i]->sequence, i);
+        EXPECT_GT(received[i]->timestamp, 0u);
+    }
+
+    // Unused slots from the batch went straight back to the pool
+    EXPECT_EQ(pool.available(), pool.capacity() - count);
+
+    for (auto* msg : received) pool.release(msg);
+    EXPECT_EQ(pool.available(), pool.capacity());
+}
+
+TEST(UdpReceiverTest, EmptySocketReturnsSlots) {
+    MessagePool pool(4);
+    LoopbackPair sockets;
+    UdpReceiver receiver(pool, sockets.rx, 4);
+
+    std::vector<NetworkMessage*> received;
+    EXPECT_EQ(receiver.receive(received), 0);
+    EXPECT_TRUE(received.empty());
+    EXPECT_EQ(pool.available(), pool.capacity());
+}
+
+TEST(UdpReceiverTest, BatchLimitedByPool) {
+    MessagePool pool(2);
+    LoopbackPair sockets;
+    UdpReceiver receiver(pool, sockets.rx, 8);
+
+    for (int i = 0; i < 5; ++i) sockets.send("msg" + std::to_string(i));
+
+    std::vector<NetworkMessage*> received;
+    EXPECT_EQ(receiver.receive(received), 2);
+    EXPECT_EQ(pool.available(), 0);
+    EXPECT_EQ(std::string(received[0]->data, received[0]->length), "msg0");
+
+    for (auto* msg : received) pool.release(msg);
+    received.clear();
+    EXPECT_EQ(receiver.receive(received), 2);
+    EXPECT_EQ(std::string(received[0]->data, received[0]->length), "msg2");
+    EXPECT_EQ(received[0]->sequence, 2u);
+    for (auto* msg : received) pool.release(msg);
+}
+
+TEST(UdpReceiverTest, DropsOversizedDatagrams) {
+    MessagePool pool(8);
+    LoopbackPair sockets;
+    UdpReceiver receiver(pool, sockets.rx, 8);
+
+    sockets.send("before");
+    sockets.send(std::string(sizeof(NetworkMessage::data) + 44, 'x'));
+    sockets.send("after");
+
+    std::vector<NetworkMessage*> received;
+    ASSERT_EQ(receiver.receive(received), 2);
+    EXPECT_EQ(receiver.truncated(), 1u);
+    EXPECT_EQ(std::string(received[0]->data, received[0]->length), "before");
+    EXPECT_EQ(std::string(received[1]->data, received[1]->length), "after");
+    EXPECT_EQ(received[1]->sequence, 1u);
+
+    // The truncated datagram's slot went back with the unused ones
+    EXPECT_EQ(pool.available(), pool.capacity() - 2);
+    for (auto* msg : received) pool.release(msg);
+}
@@ -0,0 +1,160 @@
+#include "udp_transmitter.h"
+#include "udp_receiver.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+TEST(UdpTransmitterTest, SendsBatchOverLoopback) {
+    MessagePool pool(8);
+
+    int rx = ::socket(AF_INET, SOCK_DGRAM, 0);
+    int tx = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(rx, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    socklen_t len = sizeof(addr);
+    ::getsockname(rx, reinterpret_cast<sockaddr*>(&addr), &len);
+    ASSERT_EQ(::connect(tx, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+
+    std::vector<std::string> payloads = {"new", "cancel", "replace"};
+    std::vector<NetworkMessage*> batch;
+    for (const auto& p : payloads) {
+        auto* msg = pool.borrow();
+        std::memcpy(msg->data, p.data(), p.size());
+        msg->length = static_cast<uint16_t>(p.size());
+        batch.push_back(msg);
+    }
+
+    UdpTransmitter transmitter(pool, tx);
+    EXPECT_EQ(transmitter.send(batch.data(), batch.size()), payloads.size());
+    EXPECT_EQ(transmitter.pending(), 0);
+    EXPECT_EQ(pool.available(), pool.capacity());
+
+    UdpReceiver receiver(pool, rx);
+    std::vector<NetworkMessage*> received;
+    ASSERT_EQ(receiver.receive(received), payloads.size());
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        EXPECT_EQ(std::string(received[i]->data, received[i]->length), payloads[i]);
+        pool.release(received[i]);
+    }
+
+    ::close(rx);
+    ::close(tx);
+}
+
+TEST(UdpTransmitterTest, PartialStreamWriteResumes) {
+    MessagePool pool(64);
+
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    int sndbuf = 4096;
+    ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    ::fcntl(fds[0], F_SETFL, ::fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    // Each message carries its index in every byte so the stream can be checked
+    std::string expected;
+    UdpTransmitter transmitter(pool, fds[0], 16);
+    for (size_t i = 0; i < pool.capacity(); ++i) {
+        auto* msg = pool.borrow();
+        std::memset(msg->data, static_cast<int>('A' + i % 26), sizeof(msg->data));
+        msg->length = 200;
+        transmitter.enqueue(msg);
+        expected.append(200, static_cast<char>('A' + i % 26));
+    }
+
+    transmitter.flush();
+    ASSERT_GT(transmitter.pending(), 0) << "socket buffer too large to force a partial write";
+    EXPECT_EQ(pool.available(), pool.capacity() - transmitter.pending());
+
+    std::string stream;
+    char buf[4096];
+    while (stream.size() < expected.size()) {
+        ssize_t n = ::read(fds[1], buf, sizeof(buf));
+        ASSERT_GT(n, 0);
+        stream.append(buf, static_cast<size_t>(n));
+        transmitter.flush();
+    }
+
+    EXPECT_EQ(transmitter.pending(), 0);
+    EXPECT_EQ(stream, expected);
+    EXPECT_EQ(pool.available(), pool.capacity());
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST(UdpTransmitterTest, DropPendingReturnsSlots) {
+    MessagePool pool(4);
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+    ::close(fds[1]); // Peer gone: sends fail
+
+    {
+        UdpTransmitter transmitter(pool, fds[0]);
+        for (int i = 0; i < 2; ++i) {
+            auto* msg = pool.borrow();
+            msg->length = 10;
+            transmitter.enqueue(msg);
+        }
+        EXPECT_THROW(transmitter.flush(), std::runtime_error);
+        EXPECT_EQ(transmitter.pending(), 2);
+    }
+
+    // Destructor released what the kernel never took
+    EXPECT_EQ(pool.available(), pool.capacity());
+    ::close(fds[0]);
+}
+
+TEST(UdpTransmitterTest, RejectedDatagramIsDropped) {
+    MessagePool pool(4);
+    int tx = ::socket(AF_INET, SOCK_DGRAM, 0); // Not connected: no destination
+
+    UdpTransmitter transmitter(pool, tx);
+    for (int i = 0; i < 2; ++i) {
+        auto* msg = pool.borrow();
+        msg->length = 10;
+        transmitter.enqueue(msg);
+    }
+
+    // Each flush gives up on the datagram at the head instead of retrying it
+    EXPECT_THROW(transmitter.flush(), std::runtime_error);
+    EXPECT_EQ(transmitter.pending(), 1u);
+    EXPECT_EQ(transmitter.dropped(), 1u);
+    EXPECT_EQ(pool.available(), pool.capacity() - 1);
+    EXPECT_THROW(transmitter.flush(), std::runtime_error);
+    EXPECT_EQ(transmitter.pending(), 0u);
+    EXPECT_EQ(transmitter.dropped(), 2u);
+    EXPECT_EQ(pool.available(), pool.capacity());
+    ::close(tx);
+}
+
+TEST(UdpTransmitterTest, RefusesForeignAndSurvivesDoubleRelease) {
+    MessagePool pool(4);
+    MessagePool other(1);
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+
+    {
+        UdpTransmitter transmitter(pool, fds[0]);
+        auto* foreign = other.borrow();
+        EXPECT_THROW(transmitter.enqueue(foreign), std::invalid_argument);
+        EXPECT_THROW(transmitter.send(&foreign, 1), std::invalid_argument);
+        EXPECT_EQ(transmitter.pending(), 0u);
+        other.release(foreign);
+
+        auto* kept = pool.borrow();
+        auto* lost = pool.borrow();
+        transmitter.enqueue(lost);
+        transmitter.enqueue(kept);
+        pool.release(lost); // Caller bug: released while still queued
+        // The destructor skips it instead of terminating, and returns the rest
+    }
+    EXPECT_EQ(pool.available(), pool.capacity());
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
@@ -0,0 +1,193 @@
+#include "uring_reader.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#include <unistd.h>
+
+namespace {
+
+std::unique_ptr<UringReader> makeReader(MessagePool& pool) {
+    try {
+        return std::make_unique<UringReader>(pool);
+    } catch (const std::runtime_error&) {
+        return nullptr;
+    }
+}
+
+// True if path is on tmpfs or hugetlbfs, whose pages can be pinned.
+bool onMemoryFilesystem(const std::string& path) {
+    struct statfs fs;
+    if (::statfs(path.c_str(), &fs) != 0) return false;
+    return fs.f_type == TMPFS_MAGIC || fs.f_type == HUGETLBFS_MAGIC;
+}
+
+} // namespace
+
+TEST(UringReaderTest, FixedReadsFromFile) {
+    MessagePool pool(8);
+    auto reader = makeReader(pool);
+    if (!reader) GTEST_SKIP() << "io_uring unavailable";
+
+    std::string path = ::testing::TempDir() + "uring_reader_" + std::to_string(::getpid()) + ".bin";
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    ASSERT_GE(fd, 0);
+    for (char c : {'a', 'b', 'c'}) {
+        std::string record(sizeof(NetworkMessage::data), c);
+        ASSERT_EQ(::write(fd, record.data(), record.size()), static_cast<ssize_t>(record.size()));
+    }
+
+    NetworkMessage* msgs[3];
+    ASSERT_EQ(pool.borrowBatch(msgs, 3), 3);
+    for (size_t i = 0; i < 3; ++i) {
+        reader->submitRead(fd, msgs[i], i * sizeof(NetworkMessage::data));
+    }
+
+    std::vector<UringCompletion> completions;
+    while (completions.size() < 3) {
+        reader->wait(completions);
+    }
+
+    for (const auto& c : completions) {
+        EXPECT_EQ(c.result, static_cast<int>(sizeof(NetworkMessage::data)));
+        EXPECT_EQ(c.msg->length, sizeof(NetworkMessage::data));
+        EXPECT_EQ(c.msg, pool.slotAt(c.index));
+        size_t record = static_cast<size_t>(std::find(msgs, msgs + 3, c.msg) - msgs);
+        ASSERT_LT(record, 3u);
+        EXPECT_EQ(c.msg->data[0], static_cast<char>('a' + record));
+        EXPECT_EQ(c.msg->data[255], static_cast<char>('a' + record));
+    }
+
+    pool.releaseBatch(msgs, 3);
+    ::close(fd);
+    ::unlink(path.c_str());
+}
+
+TEST(UringReaderTest, SplitsSlabAcrossFixedBuffers) {
+    MessagePool pool(8);
+    std::unique_ptr<UringReader> reader;
+    try {
+        reader = std::make_unique<UringReader>(pool, 64, 3 * MessagePool::slotStride());
+    } catch (const std::runtime_error&) {
+        GTEST_SKIP() << "io_uring unavailable";
+    }
+    EXPECT_EQ(reader->bufferCount(), 3u);
+
+    std::string path = ::testing::TempDir() + "uring_split_" + std::to_string(::getpid()) + ".bin";
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    ASSERT_GE(fd, 0);
+    for (size_t i = 0; i < 8; ++i) {
+        std::string record(sizeof(NetworkMessage::data), static_cast<char>('a' + i));
+        ASSERT_EQ(::write(fd, record.data(), record.size()), static_cast<ssize_t>(record.size()));
+    }
+
+    // Every slot, so the reads cover all three registered runs
+    NetworkMessage* msgs[8];
+    ASSERT_EQ(pool.borrowBatch(msgs, 8), 8);
+    for (size_t i = 0; i < 8; ++i) {
+        reader->submitRead(fd, msgs[i], i * sizeof(NetworkMessage::data));
+    }
+
+    std::vector<UringCompletion> completions;
+    while (completions.size() < 8) {
+        reader->wait(completions);
+    }
+    for (const auto& c : completions) {
+        ASSERT_EQ(c.result, static_cast<int>(sizeof(NetworkMessage::data)));
+        size_t record = static_cast<size_t>(std::find(msgs, msgs + 8, c.msg) - msgs);
+        ASSERT_LT(record, 8u);
+        EXPECT_EQ(c.msg->data[0], static_cast<char>('a' + record));
+        EXPECT_EQ(c.msg->data[255], static_cast<char>('a' + record));
+    }
+
+    pool.releaseBatch(msgs, 8);
+    ::close(fd);
+    ::unlink(path.c_str());
+}
+
+TEST(UringReaderTest, RegistersFileBackedPoolOnTmpfs) {
+    {
+        MessagePool probe(1);
+        if (!makeReader(probe)) GTEST_SKIP() << "io_uring unavailable";
+    }
+    if (!onMemoryFilesystem("/dev/shm")) GTEST_SKIP() << "/dev/shm is not tmpfs";
+
+    std::string path = "/dev/shm/uring_pool_" + std::to_string(::getpid()) + ".bin";
+    {
+        MessagePool pool(path, 4);
+        UringReader reader(pool);
+        EXPECT_EQ(reader.bufferCount(), 1u);
+    }
+    ::unlink(path.c_str());
+}
+
+TEST(UringReaderTest, RejectsFileBackedPoolOnDisk) {
+    {
+        MessagePool probe(1);
+        if (!makeReader(probe)) GTEST_SKIP() << "io_uring unavailable";
+    }
+    // The build directory is the fallback when TempDir() is in memory
+    std::string dir = ::testing::TempDir();
+    if (onMemoryFilesystem(dir)) dir = "./";
+    if (onMemoryFilesystem(dir)) GTEST_SKIP() << "no disk-backed directory to test with";
+
+    std::string path = dir + "uring_pool_" + std::to_string(::getpid()) + ".bin";
+    {
+        MessagePool pool(path, 4);
+        try {
+            UringReader reader(pool);
+            ADD_FAILURE() << "registered a pool backed by " << path;
+        } catch (const std::runtime_error& e) {
+            EXPECT_NE(std::string(e.what()).find("file-backed"), std::string::npos) << e.what();
+        }
+    }
+    ::unlink(path.c_str());
+}
+
+TEST(UringReaderTest, FixedReadFromSocket) {
+    MessagePool pool(4);
+    auto reader = makeReader(pool);
+    if (!reader) GTEST_SKIP() << "io_uring unavailable";
+
+    int rx = ::socket(AF_INET, SOCK_DGRAM, 0);
+    int tx = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(rx, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    socklen_t len = sizeof(addr);
+    ::getsockname(rx, reinterpret_cast<sockaddr*>(&addr), &len);
+
+    auto* msg = pool.borrow();
+    reader->submitRead(rx, msg);
+    reader->submit();
+
+    std::string payload = "quote";
+    ::sendto(tx, payload.data(), payload.size(), 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+
+    std::vector<UringCompletion> completions;
+    reader->wait(completions);
+    ASSERT_EQ(completions.size(), 1u);
+    EXPECT_EQ(completions[0].msg, msg);
+    ASSERT_EQ(completions[0].result, static_cast<int>(payload.size()));
+    EXPECT_EQ(std::string(msg->data, msg->length), payload);
+
+    pool.release(msg);
+    ::close(rx);
+    ::close(tx);
+}
+
+TEST(UringReaderTest, RejectsForeignMessage) {
+    MessagePool pool(2);
+    auto reader = makeReader(pool);
+    if (!reader) GTEST_SKIP() << "io_uring unavailable";
+
+    NetworkMessage foreign{};
+    EXPECT_THROW(reader->submitRead(0, &foreign), std::runtime_error);
+}